@@ -70,6 +70,8 @@ void initSharedNotification(comm_data *cd, solver_data *sd)
 			, &maxRecvSz
 			, &max_nelem_send
 			, &max_nelem_recv
+			, NULL
+			, NULL
 			, num_type 
 			, MPI_COMM_SHM
 			, MPI_COMM_WORLD
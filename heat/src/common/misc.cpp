@@ -136,6 +136,8 @@ int initSharedNotification(HeatConfiguration &conf, int nbx, int nby)
 			, maxRecvSz
 			, max_nelem_send
 			, max_nelem_recv
+			, NULL
+			, NULL
 			, num_type 
 			, MPI_COMM_SHM
 			, MPI_COMM_WORLD
@@ -187,6 +189,10 @@ int initSharedNotification(HeatConfiguration &conf, int nbx, int nby)
 		recv_offset[j] = ((nbx-1)*nby + by) * sizeof(block_t) + 0 * sizeof(row_t);
 	    }
 	}
+
+	shan_comm_type_commit(&conf.neighborhood_id
+			      , i
+	    );
     }
 
     check_free(neighbors);
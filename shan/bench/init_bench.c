@@ -0,0 +1,170 @@
+/*
+    Copyright (c) T-Systems SfR, C.Simmendinger <christian.simmendinger@t-systems.com>, 2018
+
+    This file is part of SHAN.
+
+    SHAN is free software: you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+	    the Free Software Foundation, either version 3 of the License, or
+	        (at your option) any later version.
+
+    SHAN is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+	    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	        GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+        along with SHAN.  If not, see <https://www.gnu.org/licenses/>.
+	
+*/
+
+
+/*
+ * Startup benchmark for shan_comm_init_comm / shan_comm_free_comm.
+ *
+ * Every rank talks to 2*k neighbors (rank +- 1 .. k, periodic), 
+ * k = 13 by default (26 neighbors, as in a 27 point stencil).
+ * k is clamped to 1 .. nProc/2, with an even number of ranks 
+ * rank + nProc/2 is only counted once. Needs at least 2 ranks.
+ * The neighbor meta data negotiation only involves these neighbors, 
+ * i.e. the init time should stay flat with growing number of ranks.
+ * Run with increasing rank counts to see the scaling.
+ *
+ * usage: init_bench [k] [num_type] [nrep]
+ */
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "GASPI.h"
+#include "SHAN_comm.h"
+#include "assert.h"
+
+#define MIN(x,y) ((x)<(y)?(x):(y))
+#define MAX(x,y) ((x)>(y)?(x):(y))
+
+int main(int argc, char *argv[])
+{
+    int i, j, iProc, nProc;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &nProc);
+    MPI_Comm_rank(MPI_COMM_WORLD, &iProc);
+
+    gaspi_rank_t iProcGASPI, nProcGASPI;
+    SUCCESS_OR_DIE (gaspi_proc_init (GASPI_BLOCK));
+    SUCCESS_OR_DIE (gaspi_proc_rank (&iProcGASPI));
+    SUCCESS_OR_DIE (gaspi_proc_num (&nProcGASPI));
+    ASSERT(iProcGASPI == iProc);
+    ASSERT(nProcGASPI == nProc);
+
+    int const num_type = argc > 2 ? atoi(argv[2]) : 2;
+    int const nrep = argc > 3 ? atoi(argv[3]) : 10;
+    if (nProc < 2 || (argc > 1 && atoi(argv[1]) < 1) || num_type < 1 || nrep < 1)
+    {
+	if (iProc == 0)
+	{
+	    fprintf(stderr, "usage: init_bench [k >= 1] [num_type >= 1] [nrep >= 1]"
+		    ", at least 2 ranks\n");
+	}
+	SUCCESS_OR_DIE (gaspi_proc_term (GASPI_BLOCK));
+	MPI_Finalize();
+	return EXIT_FAILURE;
+    }
+    int const k = MAX(1, MIN(argc > 1 ? atoi(argv[1]) : 13, nProc / 2));
+
+    MPI_Comm MPI_COMM_SHM;
+    MPI_Comm_split_type (MPI_COMM_WORLD
+			 , MPI_COMM_TYPE_SHARED
+			 , 0
+			 , MPI_INFO_NULL
+			 , &MPI_COMM_SHM
+	);
+
+    int num_neighbors = 0;
+    int *neighbors = malloc(2 * k * sizeof(int));
+    ASSERT(neighbors != NULL);
+    for (i = 0; i < k; ++i)
+    {
+	int const next = (iProc + i + 1) % nProc;
+	int const prev = (iProc - i - 1 + nProc) % nProc;
+	neighbors[num_neighbors++] = next;
+	if (prev != next)
+	{
+	    neighbors[num_neighbors++] = prev;
+	}
+    }
+
+    long *maxSendSz = malloc(num_type * sizeof(long));
+    long *maxRecvSz = malloc(num_type * sizeof(long));
+    int *max_nelem_send = malloc(num_type * sizeof(int));
+    int *max_nelem_recv = malloc(num_type * sizeof(int));
+    ASSERT(maxSendSz != NULL && maxRecvSz != NULL);
+    ASSERT(max_nelem_send != NULL && max_nelem_recv != NULL);
+
+    double t_init = 0.0, t_free = 0.0;
+    double t_init_min = 1.e30, t_init_max = 0.0;
+    for (j = 0; j < nrep; ++j)
+    {
+	/* init_comm reduces the sizes in place */
+	for (i = 0; i < num_type; ++i)
+	{
+	    maxSendSz[i] = maxRecvSz[i] = 4096;
+	    max_nelem_send[i] = max_nelem_recv[i] = 512;
+	}
+
+	shan_neighborhood_t neighborhood_id;
+	MPI_Barrier(MPI_COMM_WORLD);
+	double t0 = MPI_Wtime();
+	shan_comm_init_comm(&neighborhood_id
+			    , 0
+			    , neighbors
+			    , num_neighbors
+			    , maxSendSz
+			    , maxRecvSz
+			    , max_nelem_send
+			    , max_nelem_recv
+			    , NULL
+			    , NULL
+			    , num_type
+			    , MPI_COMM_SHM
+			    , MPI_COMM_WORLD
+	    );
+	double t1 = MPI_Wtime();
+	shan_comm_free_comm(&neighborhood_id);
+	double t2 = MPI_Wtime();
+
+	double t[2] = {t1 - t0, t2 - t1};
+	MPI_Allreduce(MPI_IN_PLACE, t, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	t_init += t[0];
+	t_free += t[1];
+	t_init_min = MIN(t_init_min, t[0]);
+	t_init_max = MAX(t_init_max, t[0]);
+    }
+
+    if (iProc == 0)
+    {
+	printf("# nProc num_neighbors num_type init_avg(s) init_min(s) init_max(s) free_avg(s)\n");
+	printf("%6d %6d %6d %12.6f %12.6f %12.6f %12.6f\n"
+	       , nProc
+	       , num_neighbors
+	       , num_type
+	       , t_init / nrep
+	       , t_init_min
+	       , t_init_max
+	       , t_free / nrep
+	    );
+    }
+
+    free(max_nelem_recv);
+    free(max_nelem_send);
+    free(maxRecvSz);
+    free(maxSendSz);
+    free(neighbors);
+    MPI_Comm_free(&MPI_COMM_SHM);
+
+    SUCCESS_OR_DIE (gaspi_proc_term (GASPI_BLOCK));
+    MPI_Finalize();
+
+    return EXIT_SUCCESS;
+}
@@ -58,6 +58,17 @@ void f_shan_alloc_shared(const int segment_id
  */
 void f_shan_free_shared(const int segment_id);
 
+/** wrapper function for shan_register_shared
+ *     
+ * @param segment_id    - segment handle (data)
+ * @param gaspi_id      - (unique) GASPI segment id
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_register_shared(const int segment_id
+			    , const int gaspi_id
+    );
+
 
 /** wrapper function for shan_free_comm
  *     
@@ -68,6 +79,130 @@ void f_shan_free_shared(const int segment_id);
 void f_shan_free_comm(const int neighbor_hood_id);
 
 
+/** wrapper function for shan_comm_set_wait_policy
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param wait_policy      - wait policy (shan_wait_policy)
+ * @param spin_count       - spin iterations before yield/block
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_wait_policy(const int neighbor_hood_id
+			    , const int wait_policy
+			    , const int spin_count
+    );
+
+
+/** wrapper function for shan_comm_set_queues
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param num_queue        - number of queues (0 for all GASPI queues)
+ * @param queue_affinity   - queue mapping (shan_queue_affinity)
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_queues(const int neighbor_hood_id
+		       , const int num_queue
+		       , const int queue_affinity
+    );
+
+
+/** wrapper function for shan_comm_set_coalescing
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param enable           - 1 to enable coalesced writes, 0 to disable
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_coalescing(const int neighbor_hood_id
+			   , const int enable
+    );
+
+
+/** wrapper function for shan_comm_set_stream_threshold
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param type_id          - type index
+ * @param threshold        - copy size (byte), 0 for default, -1 for never
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_stream_threshold(const int neighbor_hood_id
+				 , const int type_id
+				 , const long threshold
+    );
+
+
+/** wrapper function for shan_comm_set_push
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param type_id          - type index
+ * @param enable           - 1 to enable sender push, 0 to disable
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_push(const int neighbor_hood_id
+		     , const int type_id
+		     , const int enable
+    );
+
+
+/** wrapper function for shan_comm_set_pull
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param type_id          - type index
+ * @param enable           - 1 to enable receiver pull, 0 to disable
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_pull(const int neighbor_hood_id
+		     , const int type_id
+		     , const int enable
+    );
+
+
+/** wrapper function for shan_comm_set_direct
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param type_id          - type index
+ * @param segment_id       - data segment handle (registered)
+ * @param enable           - 1 to enable direct receives, 0 to disable
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_direct(const int neighbor_hood_id
+		       , const int type_id
+		       , const int segment_id
+		       , const int enable
+    );
+
+
+/** wrapper function for shan_comm_set_stats_dump
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param enable           - 1 to print statistics in free, 0 to disable
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_stats_dump(const int neighbor_hood_id
+			   , const int enable
+    );
+
+
+/** wrapper function for shan_comm_set_unpack_team, OpenMP team
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param num_thread       - number of threads, 1 for serial unpack
+ * @param cutoff           - min receive size for a team unpack (byte)
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_set_unpack_team(const int neighbor_hood_id
+			    , const int num_thread
+			    , const long cutoff
+    );
+
+
 /** wrapper function for shan_init_comm
  *     
  * @param neighbor_hood_id - general neighborhood handle
@@ -90,6 +225,27 @@ void f_shan_init_comm(const int neighbor_hood_id
 		      , void *max_nelem_recv
 		      , int num_type
     );
+
+/** wrapper function for shan_update_comm
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param neighbors       - comm partners (neighbors)
+ * @param num_neighbors   - num comm partners (neighbors)
+ * @param maxSendSz       - max send size for every comm type (byte)
+ * @param maxRecvSz       - max recv size for every comm type (byte)
+ * @param max_nelem_send  - max number of send elements for every comm type
+ * @param max_nelem_recv  - max number of recv elements for every comm type
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_update_comm(const int neighbor_hood_id
+			, void *neighbors
+			, int num_neighbors
+			, void *maxSendSz
+			, void *maxRecvSz
+			, void *max_nelem_send
+			, void *max_nelem_recv
+    );
     
 /** wrapper function for shan_type_offset
  *     
@@ -115,6 +271,18 @@ void f_shan_type_offset(const int neighbor_hood_id
     );
 
 
+/** wrapper function for shan_comm_type_commit
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param type_id        - used type segment
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_type_commit(const int neighbor_hood_id
+			, const int type_id
+    );
+
+
 /** wrapper function for shan_comm_wait4All
  *     
  * @param neighbor_hood_id - general neighborhood handle
@@ -141,6 +309,15 @@ void f_shan_comm_wait4AllSend(const int neighbor_hood_id
     );
 
 
+/** wrapper function for shan_comm_neighborBarrier
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_comm_neighborBarrier(const int neighbor_hood_id);
+
+
 /** wrapper function for shan_comm_wait4AllRecv
  *     
  * @param neighbor_hood_id - general neighborhood handle
@@ -155,6 +332,26 @@ void f_shan_comm_wait4AllRecv(const int neighbor_hood_id
     );
 
 
+/** wrapper function for shan_comm_waitsome
+ *     
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param segment_id     - (data) segment handle
+ * @param type_id        - used type id
+ * @param stage          - total number of receives expected per neighbor, 0: as sent
+ * @param ready_idx      - comm indices (zero based) of received neighbors
+ * @param num_ready      - number of received neighbors
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_comm_waitsome(const int neighbor_hood_id  
+			  , const int segment_id
+			  , const int type_id
+			  , const int stage
+			  , int *ready_idx
+			  , int *num_ready
+    );
+
+
 /** wrapper function for shan_comm_notify_or_write
  *  
  * @param neighbor_hood_id - general neighborhood handle
@@ -169,6 +366,94 @@ void f_shan_comm_notify_or_write(const int neighbor_hood_id
 				 , const int type_id
 				 , int idx
     );
+
+
+/** wrapper function for shan_comm_notify_or_write_multi
+ *  
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param segment_id     - data segment handle
+ * @param type_ids       - used type ids
+ * @param num_type_ids   - number of type ids
+ * @param idx            - comm index for target rank in neighborhood
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_comm_notify_or_write_multi(const int neighbor_hood_id
+				       , const int segment_id
+				       , int *type_ids
+				       , const int num_type_ids
+				       , int idx
+    );
+
+
+/** wrapper function for shan_comm_init_reduce
+ *     
+ * @param reduce_id        - reduction handle id
+ * @param neighbor_hood_id - general neighborhood handle
+ * @param segment_id       - shared and GASPI segment id of the reduction
+ * @param max_count        - max number of elements per reduction
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_init_reduce(const int reduce_id
+			, const int neighbor_hood_id
+			, const int segment_id
+			, const int max_count
+    );
+
+
+/** wrapper function for shan_comm_free_reduce
+ *     
+ * @param reduce_id        - reduction handle id
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_free_reduce(const int reduce_id);
+
+
+/** wrapper function for shan_comm_allreduce
+ *     
+ * @param reduce_id        - reduction handle id
+ * @param sendbuf          - own contribution
+ * @param recvbuf          - result
+ * @param count            - number of elements
+ * @param op               - reduction operation (shan_reduce_op)
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_allreduce(const int reduce_id
+		      , double *sendbuf
+		      , double *recvbuf
+		      , const int count
+		      , const int op
+    );
+
+
+/** wrapper function for shan_comm_allreduce_start
+ *     
+ * @param reduce_id        - reduction handle id
+ * @param sendbuf          - own contribution
+ * @param recvbuf          - result
+ * @param count            - number of elements
+ * @param op               - reduction operation (shan_reduce_op)
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_allreduce_start(const int reduce_id
+			    , double *sendbuf
+			    , double *recvbuf
+			    , const int count
+			    , const int op
+    );
+
+
+/** wrapper function for shan_comm_allreduce_wait
+ *     
+ * @param reduce_id        - reduction handle id
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+void f_shan_allreduce_wait(const int reduce_id);
     
 
 
@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "GASPI.h"
 #include "SHAN_segment.h"
@@ -38,10 +39,89 @@ extern "C"
 /** \file SHAN_comm.h
  *  \brief SHAN_comm header for persistant communication in shared memory.
  *   
+ *  Thread safety: all communication state is kept per type. Different 
+ *  threads can drive different types of a neighborhood concurrently 
+ *  (and different neighbors of a type with the per neighbor test/wait 
+ *  functions). A given (type, neighbor) pair must not be used by more 
+ *  than one thread at a time. With SHAN_QUEUE_THREAD (shan_comm_set_queues)
+ *  every thread posts to its own GASPI queue, which requires that a type 
+ *  is always driven by the same thread. Init, free, set_queues and 
+ *  set_wait_policy are not thread-safe.
  */
 
 #define MAX_SHARED_NOTIFICATION 2 //!< 'have written' and 'have read' synchronization
 
+/** Format of the element offset descriptors of a type.
+ */
+enum shan_offset_format {
+    SHAN_OFFSET_INDEXED = 0,     //!< one offset per element (default)
+    SHAN_OFFSET_BLOCK   = 1      //!< base + stride + count blocks
+};
+
+
+/** Mapping of (type, neighbor) communication to GASPI queues.
+ */
+enum shan_queue_affinity {
+    SHAN_QUEUE_NEIGHBOR = 0,     //!< queue per neighbor (default)
+    SHAN_QUEUE_TYPE     = 1,     //!< queue per type
+    SHAN_QUEUE_THREAD   = 2      //!< queue per calling thread
+};
+
+
+/** Wait policy of the SHAN wait functions.
+ */
+enum shan_wait_policy {
+    SHAN_WAIT_SPIN  = 0,         //!< busy wait (default)
+    SHAN_WAIT_YIELD = 1,         //!< spin, then yield the core
+    SHAN_WAIT_BLOCK = 2          //!< spin, then block on shared notifications (futex)
+};
+
+
+/** Parallel for of a thread team, runs chunk(arg, i) for i = 0 .. num_chunk-1.
+ *  Returns after all chunks are done.
+ */
+typedef void (*shan_parallel_for_t)(int num_chunk
+				    , void (*chunk)(void *arg, int ichunk)
+				    , void *arg
+				    , void *user_data
+    );
+
+
+/** Thread team for unpacking large receives.
+ */
+typedef struct
+{
+    int num_thread;                   //!< number of chunks per receive, 1 for serial unpack
+    long cutoff;                      //!< min receive size for a team unpack (byte)
+    shan_parallel_for_t parallel_for; //!< user parallel for, NULL for OpenMP
+    void *user_data;                  //!< passed to parallel_for
+} shan_unpack_team_t;
+
+
+/** Offset block, nelem elements at offsets base + i * stride.
+ */
+typedef struct
+{
+    long base;                   //!< offset of first element (byte)
+    long stride;                 //!< offset stride (byte)
+    int nelem;                   //!< number of elements in block
+} shan_offset_block_t;
+
+
+/** Read-only view of received node local data, in place.
+ *  Element i is at base + offset[i] (SHAN_OFFSET_INDEXED) or 
+ *  within the offset blocks (SHAN_OFFSET_BLOCK).
+ */
+typedef struct
+{
+    void const *base;                  //!< data segment base of the viewed rank
+    int nelem;                         //!< number of elements
+    int elem_sz;                       //!< element size (byte)
+    long const *offset;                //!< element offsets (byte), NULL for blocks
+    shan_offset_block_t const *block;  //!< offset blocks, NULL for offsets
+    int nblock;                        //!< number of offset blocks
+} shan_view_t;
+
 
 /** Type struct, visible in shared memory
  */
@@ -52,11 +132,84 @@ typedef struct
     int *nelem_recv;             //!< current num recv elements per neighbor
     int *send_sz;                //!< current send size (in char) per neighbor
     int *recv_sz;                //!< current recv size (in char) per neighbor  
-    long *send_offset;           //!< list of send offsets per neighbor
-    long *recv_offset;           //!< list of recv offsets per neighbor
+    int *send_version;           //!< commit count of send offsets per neighbor
+    int *nblock_send;            //!< current num send offset blocks per neighbor
+    int *nblock_recv;            //!< current num recv offset blocks per neighbor
+    int *recv_version;           //!< commit count of recv offsets per neighbor
+    int *recv_ready;             //!< recv stage which may be pushed into data per neighbor (push mode)
+    int *push_count;             //!< last send stage pushed into receiver data per neighbor (push mode)
+    long *send_offset;           //!< list of send offsets per neighbor (SHAN_OFFSET_INDEXED)
+    long *recv_offset;           //!< list of recv offsets per neighbor (SHAN_OFFSET_INDEXED)
+    shan_offset_block_t *send_block; //!< list of send offset blocks per neighbor (SHAN_OFFSET_BLOCK)
+    shan_offset_block_t *recv_block; //!< list of recv offset blocks per neighbor (SHAN_OFFSET_BLOCK)
+    int max_nelem_send;          //!< send offset list stride per neighbor, of owning rank
+    int max_nelem_recv;          //!< recv offset list stride per neighbor, of owning rank
 } type_local_t;
 
 
+/** Prepared communication handle per (type, neighbor).
+ *  Caches shared type pointers, buffer offsets and notification ids,
+ *  which are fixed after shan_comm_init_comm.
+ */
+typedef struct
+{
+    int local_rank;              //!< node local rank of neighbor, -1 for remote neighbors
+    type_local_t remote_type;    //!< shared type data of node local neighbor
+    long send_sz;                //!< size of a send buffer, incl. header (byte)
+    long recv_sz;                //!< size of a recv buffer, incl. header (byte)
+    long *send_buffer;           //!< send buffer offset in remote segment, per ring buffer
+    long *recv_buffer;           //!< recv buffer offset in remote segment, per ring buffer
+    long *remote_recv_buffer;    //!< recv buffer offset in remote segment of neighbor, per ring buffer
+    long *remote_send_buffer;    //!< send buffer offset in remote segment of neighbor, per ring buffer (pull mode)
+    int *notify_id;              //!< GASPI notification id at neighbor, per ring buffer
+    int batch_notify_id;         //!< GASPI notification id at neighbor for coalesced writes led by this type
+    uint64_t *remote_mailbox;    //!< mailbox of node local neighbor for this type
+    int remote_mailbox_nword;    //!< summary words per direction in remote_mailbox
+} shan_handle_t;
+
+
+
+/** Copy block, run of nelem elements with constant src/dest strides.
+ */
+typedef struct
+{
+    long src;                    //!< first source offset (byte)
+    long dest;                   //!< first destination offset (byte)
+    long src_stride;             //!< source stride (byte)
+    long dest_stride;            //!< destination stride (byte)
+    int nelem;                   //!< number of elements in block
+} shan_copy_block_t;
+
+
+/** Compiled copy plan, rank_local, coalesced element offsets.
+ */
+typedef struct
+{
+    int nelem;                   //!< num elements covered by plan, -1 if not compiled
+    int elem_sz;                 //!< element size (byte)
+    int nblock;                  //!< num copy blocks
+    int src_version;             //!< commit count of source offsets
+    int dest_version;            //!< commit count of destination offsets
+    shan_copy_block_t *block;    //!< list of copy blocks
+} shan_copy_plan_t;
+
+
+/** Communication statistics per (type, neighbor).
+ *  Counted if SHAN is built with USE_SHAN_STATS, zero otherwise.
+ */
+typedef struct
+{
+    int  local;                  //!< 1 for node local neighbor, 0 for remote
+    long num_send;               //!< number of sends
+    long num_recv;               //!< number of receives
+    long bytes_send;             //!< payload sent (byte)
+    long bytes_recv;             //!< payload received (byte)
+    long queue_full;             //!< sends which found their GASPI queue full
+    double wait_send;            //!< time spent in shan_comm_wait4Send (s)
+    double wait_recv;            //!< time spent in shan_comm_wait4Recv/wait4View (s)
+} shan_stats_t;
+
+
 /** Segment struct, rank_local, holds all segment information.
  */
 typedef struct
@@ -71,17 +224,45 @@ typedef struct
  */
 typedef struct
 {
-    long maxSendSz;              //!< max send size per type (byte)
-    long maxRecvSz;              //!< max recv size per type (byte)
-    int  max_nelem_send;         //!< max recv size per type (byte)
-    int  max_nelem_recv;         //!< max recv size per type (byte)
-    long SendOffset[2];          //!< local offset for send per type (byte)
-    long RecvOffset[2];          //!< local offset for recv per type (byte)
+    long maxSendSz;              //!< max send size per type, incl. header (byte)
+    long maxRecvSz;              //!< max recv size per type, incl. header (byte)
+    int  max_nelem_send;         //!< max num send elements (or blocks) per type
+    int  max_nelem_recv;         //!< max num recv elements (or blocks) per type
+    int  offset_format;          //!< offset descriptor format per type
+    int  num_buffer;             //!< depth of remote buffer ring per type
+    long stream_threshold;       //!< min copy size for non-temporal stores per type (byte), -1 for never
+    int  push;                   //!< node local sends push into receiver data per type
+    int  pull;                   //!< remote receivers read the send buffers of the sender per type
+    int  direct;                 //!< remote senders place receives directly into receiver data per type
+    long *SendSz;                //!< send buffer size per neighbor, incl. header (byte)
+    long *RecvSz;                //!< recv buffer size per neighbor, incl. header (byte)
+    long *SendOffset;            //!< local offset for send per neighbor, first ring buffer (byte)
+    long *RecvOffset;            //!< local offset for recv per neighbor, first ring buffer (byte)
+    long *RemoteRecvOffset;      //!< remote offset for recv per neighbor, first ring buffer (byte)
+    long *RemoteSendOffset;      //!< remote offset for send per neighbor, first ring buffer (byte)
     long elemOffset;             //!< element offset in shared mem
 
     int *local_send_count;      //!< send stage counter array, per type
     int *local_recv_count;      //!< recv stage counter array, per type
     int *local_ack_count;       //!< acknowledge stage counter array, per type
+    int *zero_copy_pending;     //!< queue + 1 of zero copy send not yet locally complete, per type
+    int *direct_count;          //!< last announced direct receive stage, per type
+    int *pull_count;            //!< recv stage with a posted read (pull mode), per type
+    int *local_stage_count;     //!< stage counter for wait4All(Send/Recv), per type
+    int *batch_prev;            //!< stage of last coalesced write led by this type, per type
+    int *batch_seen;            //!< last processed coalesced write led by this type, per type
+    volatile int *batch_ready;  //!< stage received by coalesced writes, per type and ring buffer
+    uint64_t *mailbox;          //!< own shared mailbox, 'have written' + 'have read' summary words, per type
+    uint64_t *mailbox_pending;  //!< summary bits taken from mailbox, not yet consumed, per type
+
+    int commit_count;           //!< number of type commits
+    type_local_t local_type;    //!< shared type data of own rank (cached)
+    shan_handle_t *handle;      //!< prepared comm handles per neighbor
+    shan_copy_plan_t *send_plan;   //!< pack plan per neighbor (remote)
+    shan_copy_plan_t *recv_plan;   //!< unpack plan per neighbor (remote)
+    shan_copy_plan_t *local_plan;  //!< type conversion plan per neighbor (shared mem)
+    shan_copy_plan_t *push_plan;   //!< type conversion plan per neighbor (shared mem, push mode)
+    shan_stats_t *stats;        //!< communication statistics per neighbor
     
 } shan_element_t;
 
@@ -94,20 +275,40 @@ typedef struct
     int neighbor_hood_id;       //!< neighborhood id
     MPI_Comm MPI_COMM_SHM;      //!< shared MPI communicator
     MPI_Comm MPI_COMM_ALL;      //!< global MPI communicator
+    MPI_Comm MPI_COMM_GRAPH;    //!< distributed graph communicator of the neighborhood
 
     int num_neighbors;          //!< num comm partners (neighbors)
     int num_local;              //!< node local number of comm partners
     int *neighbors;             //!< list of neighbors, per rank
     int *RemoteCommIndex;       //!< the remote index corresponding to own rank
     int *RemoteNumNeighbors;    //!< remote number of neighbors for RemoteCommIndex
+    long *RemoteMaxSendSz;      //!< remote max send size, per neighbor and type (byte)
+    long *RemoteMaxRecvSz;      //!< remote max recv size, per neighbor and type (byte)
+    int *RemoteMaxNelemSend;    //!< remote max send elements, per neighbor and type
+    int *RemoteMaxNelemRecv;    //!< remote max recv elements, per neighbor and type
 
     int num_type;               //!< num types
+    int num_buffer_max;         //!< max remote buffer ring depth of all types
     long *typeOffset;           //!< type offsets for all node local ranks
 
     shan_segment_t shared_segment; //!< shared window for local communication
     shan_element_t *type_element;  //!< local comm data for remote communication.
 
     long remoteSz;              //!< remote comm size, all types, send + recv (byte)
+    long commSz;                //!< send + recv buffer size, all neighbors (byte)
+    int num_queue;              //!< size of GASPI queue pool (queues 0 .. num_queue-1)
+    int queue_affinity;         //!< queue mapping (shan_queue_affinity)
+    int queue_size_max;         //!< max requests per GASPI queue
+    long queue_stall;           //!< number of blocking waits on full queues
+    long queue_spill;           //!< number of posts moved to another queue of the pool
+    int stats_dump;             //!< print statistics in shan_comm_free_comm
+    int wait_policy;            //!< wait policy (shan_wait_policy)
+    int wait_spin;              //!< spin iterations before yield/block
+    int coalesce;               //!< coalesced multi-type writes enabled
+    int write_list_max;         //!< max entries per GASPI write list
+    shan_unpack_team_t unpack_team; //!< thread team for large unpacks
+    int *direct_segment;        //!< data segment registered for direct receives, per neighbor
+    int direct_gaspi_id;        //!< GASPI id of the data segment for direct receives, -1 for none
     shan_remote_t remote_segment;  //!< private segment for remote communication  
     
     int nProcLocal;             //!< num local ranks in shared mem
@@ -115,25 +316,31 @@ typedef struct
     int nProcGlobal;            //!< num global ranks
     int iProcGlobal;            //!< global rank id
 
-    int master;                 //!< master of shared segment (local rank 0)
-    int *remote_master;         //!< global list of masters
+    int *local_rank;            //!< node local rank (MPI_COMM_SHM) per neighbor, -1 for remote
+
+    int *signal_send_count;     //!< signals sent, per neighbor
+    int *signal_recv_count;     //!< signals received, per neighbor
+    int *signal_seen;           //!< highest signal count notified by remote neighbor, per neighbor
 
-    int *local_stage_count;     //!< generic stage counter for wait4All(Send/Recv)
+    volatile int batch_lock;    //!< lock for processing coalesced writes
     
 } shan_neighborhood_t;
 
 /** Gets node local rank id.
+ *  Locality is taken from MPI_COMM_SHM, i.e. does not depend on 
+ *  the rank placement. Neighbors are looked up, other ranks translated.
  *  
  * @param neighborhood_id - handle for neighborhood
  * @param rank            - global rank
  *
- * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ * @return rank in MPI_COMM_SHM, -1 for ranks on other nodes.
  */
 int shan_comm_local_rank(shan_neighborhood_t * const neighborhood_id
 			 , const int rank
     );
 
 /** Increments counter in shared mem
+ *  and sets the own bit in the mailbox of the target rank.
  *  
  * @param neighborhood_id - general neighborhood handle
  * @param type_id        - type index
@@ -152,18 +359,34 @@ int shan_increment_local(shan_neighborhood_t *const neighborhood_id
  * 
  *  A zero length messages will work, no message at all will fail.
  * 
- *  - allocates shared and private mem for communication (double buffered).
+ *  - allocates shared and private mem for communication (ring of 
+ *    num_buffer remote buffers per type, double buffered per default).
  *  - figures out local and remote comm partners.
- *  - negotiates remote number f neighbors and comm index
+ *  - negotiates remote number of neighbors, comm index and max sizes
+ *    with the neighbors only (MPI_Neighbor_alltoall on a distributed 
+ *    graph communicator, MPI_COMM_GRAPH)
  *
  * @param neighborhood_id - general neighborhood handle
  * @param neighbor_hood_id - neighborhood id
  * @param neighbors     - comm partners (neighbors)
  * @param num_neighbors - num comm partners (neighbors)
- * @param maxSendSz     - max send size for every type.
- * @param maxRecvSz     - max recv size for every type
- * @param max_nelem_send - max number of send elements per type
- * @param max_nelem_recv - max number of recv elements per type
+ * @param maxSendSz     - max send size for every type, over own neighbors.
+ * @param maxRecvSz     - max recv size for every type, over own neighbors.
+ *                        Remote buffers are sized per comm pair, with the 
+ *                        smaller of the max sizes of sender and receiver.
+ * @param max_nelem_send - max number of send elements per type, also the 
+ *                        stride of the send offset lists per neighbor
+ *                        (max number of offset blocks for SHAN_OFFSET_BLOCK)
+ * @param max_nelem_recv - max number of recv elements per type, also the 
+ *                        stride of the recv offset lists per neighbor
+ *                        (max number of offset blocks for SHAN_OFFSET_BLOCK)
+ * @param offset_format - offset descriptor format per type (shan_offset_format),
+ *                        NULL for SHAN_OFFSET_INDEXED in all types.
+ *                        Has to match between neighbors.
+ * @param num_buffer    - remote buffer ring depth per type (>= 2), NULL for 
+ *                        double buffering in all types. A sender can run up to 
+ *                        num_buffer-1 stages ahead of a remote receiver.
+ *                        Has to match between neighbors.
  * @param num_type      - number of types
  * @param MPI_COMM_SHM - MPI shared mem communicator
  * @param MPI_COMM_ALL - embedding of shared communicator (typically MPI_COMM_WORLD) 
@@ -178,12 +401,52 @@ int shan_comm_init_comm(shan_neighborhood_t *const neighborhood_id
 			, long *maxRecvSz
 			, int *max_nelem_send
 			, int *max_nelem_recv
+			, int *offset_format
+			, int *num_buffer
 			, int num_type 
 			, MPI_Comm MPI_COMM_SHM
 			, MPI_Comm MPI_COMM_ALL
     );
 
 
+/** Sets the GASPI queue pool used for remote communication.
+ *  Per default all GASPI queues are used with per-neighbor affinity.
+ *  All communication for a given (type, neighbor) pair always uses the
+ *  same queue, which preserves the GASPI ordering of data and notifications.
+ *  For SHAN_QUEUE_THREAD this requires each type to be driven by a single thread.
+ *  Must not be called with outstanding communication.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param num_queue       - number of queues (0 for all GASPI queues)
+ * @param queue_affinity  - queue mapping (shan_queue_affinity)
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_queues(shan_neighborhood_t *const neighborhood_id
+			 , int num_queue
+			 , int queue_affinity
+    );
+
+
+/** Sets the wait policy for all wait functions of the neighborhood.
+ *  Per default waits spin (SHAN_WAIT_SPIN). With SHAN_WAIT_YIELD and 
+ *  SHAN_WAIT_BLOCK, waits spin for spin_count iterations and then 
+ *  yield the core or block on the node local notification.
+ *  Remote (GASPI) notifications can not block, these are polled
+ *  with a yield or a short timeout.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param wait_policy     - wait policy (shan_wait_policy)
+ * @param spin_count      - spin iterations before yield/block
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_wait_policy(shan_neighborhood_t *const neighborhood_id
+			      , int wait_policy
+			      , int spin_count
+    );
+
+
 /** Free communication ressources
  *
  * @param neighborhood_id - general neighborhood handle
@@ -193,6 +456,58 @@ int shan_comm_init_comm(shan_neighborhood_t *const neighborhood_id
 int shan_comm_free_comm(shan_neighborhood_t *const neighborhood_id);
 
 
+/** Updates neighbors and max sizes of an initialized neighborhood in place, 
+ *  e.g. after a repartitioning. 
+ *  - collective for all ranks of MPI_COMM_ALL, ranks without changes 
+ *    pass their current neighbors and sizes.
+ *  - all communication of the neighborhood has to be complete.
+ *  - renegotiates with the (new) neighbors only, without global reductions.
+ *    Number of types, offset format and buffer ring depth are kept.
+ *  - GASPI connections and direct receive registrations are kept, 
+ *    new remote neighbors are connected.
+ *  - the remote comm segment and the shared types are reallocated 
+ *    only if they have to grow.
+ *  Types are reset as after shan_comm_init_comm, i.e. sizes and offsets 
+ *  have to be set and committed again. Queue pool, wait policy and 
+ *  coalescing settings are kept.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param neighbors     - comm partners (neighbors)
+ * @param num_neighbors - num comm partners (neighbors)
+ * @param maxSendSz     - max send size for every type, over own neighbors
+ * @param maxRecvSz     - max recv size for every type, over own neighbors
+ * @param max_nelem_send - max number of send elements per type
+ * @param max_nelem_recv - max number of recv elements per type
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_update_comm(shan_neighborhood_t *const neighborhood_id
+			  , int *neighbors
+			  , int num_neighbors
+			  , long *maxSendSz
+			  , long *maxRecvSz
+			  , int *max_nelem_send
+			  , int *max_nelem_recv
+    );
+
+
+/** Enables coalesced multi-type writes (shan_comm_notify_or_write_multi).
+ *  Receivers then also poll the coalesced notifications of a neighbor
+ *  whenever a type has not arrived through its own notification.
+ *  Collective over the neighborhood, the setting has to match 
+ *  between neighbors (checked, also by shan_comm_update_comm).
+ *  Must not be called with outstanding communication.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param enable          - 1 to enable, 0 to disable
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_coalescing(shan_neighborhood_t *const neighborhood_id
+			     , int enable
+    );
+
+
 /** Writes data or flags data as readable.
  *  
  *  - aggregates send data into linear buffer or
@@ -200,6 +515,8 @@ int shan_comm_free_comm(shan_neighborhood_t *const neighborhood_id);
  *     - number of elements 
  *     - element sizes and 
  *     - element offsets 
+ *  - for remote neighbors, announces direct placement 
+ *    of the next receive (registered data segment only)
  *
  * @param neighborhood_id - general neighborhood handle
  * @param data_segment   - data segment handle
@@ -215,6 +532,185 @@ int shan_comm_notify_or_write(shan_neighborhood_t *const neighborhood_id
     );
 
 
+/** Sets the copy size from which pack, unpack and shared memory 
+ *  conversion of a type use non-temporal (streaming) stores and
+ *  prefetch the next source run. The destination then bypasses the 
+ *  cache, which pays off for large halos that are not touched 
+ *  before the next sweep. Per default the threshold is the 
+ *  last level cache share of a node local rank.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - type index
+ * @param threshold       - copy size (byte), 0 for default, -1 for never
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_stream_threshold(shan_neighborhood_t *const neighborhood_id
+				   , int type_id
+				   , long threshold
+    );
+
+
+/** Enables sender push for node local neighbors of a type.
+ *  shan_comm_notify_or_write then converts the data directly into 
+ *  the receive locations of the neighbor and the send is complete 
+ *  on return, the receiver only observes the notification.
+ *  A neighbor announces that its receive locations are free with 
+ *  its own shan_comm_notify_or_write to us (i.e. push requires the 
+ *  usual bidirectional exchange). Sends to neighbors which have 
+ *  not announced yet, or have push disabled, fall back to receiver pull.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - type index
+ * @param enable          - 1 to enable, 0 to disable
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_push(shan_neighborhood_t *const neighborhood_id
+		       , int type_id
+		       , int enable
+    );
+
+
+/** Enables receiver pull for remote neighbors of a type.
+ *  shan_comm_notify_or_write then only packs the send buffer and 
+ *  flags it as ready, the receiver reads it (gaspi_read_notify) when 
+ *  it tests or waits for the receive, i.e. receivers schedule their 
+ *  halos themselves. Node local neighbors always read in place.
+ *  Send completion is unchanged (bidirectional exchange, buffer ring).
+ *  Has to be set by all ranks of the neighborhood for a type before 
+ *  its first communication (checked with every message).
+ *  Pulled types are not coalesced.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - type index
+ * @param enable          - 1 to enable, 0 to disable
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_pull(shan_neighborhood_t *const neighborhood_id
+		       , int type_id
+		       , int enable
+    );
+
+
+/** Enables direct receives from remote neighbors of a type.
+ *  With every send to a remote neighbor the type announces its next 
+ *  receive from that neighbor. The neighbor then writes contiguous 
+ *  messages straight into the receive offsets in data_segment and 
+ *  the unpack is skipped. Non contiguous receives, or sends which 
+ *  did not see the announcement in time, use the receive buffer.
+ *  data_segment has to be registered (shan_register_shared) and is
+ *  made remotely accessible for all remote neighbors here, i.e. this
+ *  is collective over the neighborhood. All direct types of a 
+ *  neighborhood share one data segment.
+ *
+ * Note: With direct receives, the receive area for a neighbor 
+ *       may be overwritten as soon as the next send to this 
+ *       neighbor (shan_comm_notify_or_write) has been issued, 
+ *       not only in the wait for the receive.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - type index
+ * @param data_segment    - registered segment of the receive data
+ * @param enable          - 1 to enable, 0 to disable (default)
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_direct(shan_neighborhood_t *const neighborhood_id
+			 , int type_id
+			 , shan_segment_t *const data_segment
+			 , int enable
+    );
+
+
+/** Gets the communication statistics of a type for a neighbor.
+ *  Statistics are only counted if SHAN is built with USE_SHAN_STATS
+ *  and are reset by shan_comm_update_comm.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - type index
+ * @param idx             - neighbor index
+ * @param stats           - statistics (out)
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_get_stats(shan_neighborhood_t *const neighborhood_id
+			, int type_id
+			, int idx
+			, shan_stats_t *stats
+    );
+
+
+/** Prints a table of the statistics of all types and neighbors 
+ *  per rank in shan_comm_free_comm.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param enable          - 1 to enable, 0 to disable
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_stats_dump(shan_neighborhood_t *const neighborhood_id
+			     , int enable
+    );
+
+
+/** Unpacks large receives with a thread team.
+ *  Node local type conversion (shan_comm_get_local) and unpacking of 
+ *  remote receives split the elements of a receive of at least cutoff
+ *  bytes into num_thread chunks, which are run by parallel_for.
+ *  Without parallel_for, an OpenMP parallel for with num_thread threads
+ *  is used (serial if SHAN is built without OpenMP).
+ *  Intended for hybrid runs with few ranks and many cores per rank.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param num_thread      - number of chunks/threads, 1 for serial unpack (default)
+ * @param cutoff          - min receive size for a team unpack (byte)
+ * @param parallel_for    - user parallel for, NULL for OpenMP
+ * @param user_data       - passed to parallel_for
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_set_unpack_team(shan_neighborhood_t *const neighborhood_id
+			      , int num_thread
+			      , long cutoff
+			      , shan_parallel_for_t parallel_for
+			      , void *user_data
+    );
+
+
+/** Writes data of several types to the same neighbor.
+ *  
+ *  - for remote neighbors, packs all types and writes them with 
+ *    a single GASPI write list and a single notification.
+ *    Every type still is a write list entry of its own (header + 
+ *    payload, or two entries for zero copy and direct sends) into
+ *    its own receive buffer ring, i.e. this saves notifications 
+ *    and posts, not RDMA writes.
+ *    The receiver dispatches per type, i.e. the types are 
+ *    tested/waited for individually as with shan_comm_notify_or_write.
+ *  - for node local neighbors, flags all types as readable.
+ *
+ *  Requires shan_comm_set_coalescing. The first type leads the write 
+ *  (queue and notification), a type must not appear twice.
+ *  With threads, all types of the call belong to the calling thread.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param data_segment   - data segment handle
+ * @param type_ids       - type indices
+ * @param num_type_ids   - number of type indices
+ * @param idx            - comm index for target rank in neighborhood
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_notify_or_write_multi(shan_neighborhood_t *const neighborhood_id
+				    , shan_segment_t *data_segment
+				    , int const *type_ids
+				    , int num_type_ids
+				    , int idx
+    );
+
+
 /** Waits for entire neighborhood
  *  
  *  - waits for either shared memory notifications
@@ -290,6 +786,121 @@ int shan_comm_test4Recv(shan_neighborhood_t *const neighborhood_id
 			, int idx
     );
 
+
+/** Waits for a receive from a node local neighbor without copying.
+ *  Returns a view of the send elements of the neighbor in its own 
+ *  data segment (base pointer + send offsets), i.e. the halo is read 
+ *  where it is. The send of the neighbor only completes with 
+ *  shan_comm_release_view, the view is valid until then.
+ *  Data pushed by the neighbor (shan_comm_set_push) already is in
+ *  the own receive locations, the view then describes these.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param data_segment   - data segment handle
+ * @param type_id        - type index
+ * @param idx            - comm index of a node local neighbor
+ * @param view           - view of the received data
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_wait4View(shan_neighborhood_t *const neighborhood_id
+			, shan_segment_t *data_segment
+			, int type_id
+			, int idx
+			, shan_view_t *view
+    );
+
+
+/** Tests for a receive from a node local neighbor without copying,
+ *  see shan_comm_wait4View.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param data_segment   - data segment handle
+ * @param type_id        - type index
+ * @param idx            - comm index of a node local neighbor
+ * @param view           - view of the received data
+ *
+ * @return SHAN_COMM_SUCCESS if received, -1 otherwise.
+ */
+int shan_comm_test4View(shan_neighborhood_t *const neighborhood_id
+			, shan_segment_t *data_segment
+			, int type_id
+			, int idx
+			, shan_view_t *view
+    );
+
+
+/** Releases a view (shan_comm_wait4View/shan_comm_test4View),
+ *  which completes the send of the neighbor.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id        - type index
+ * @param idx            - comm index of a node local neighbor
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_release_view(shan_neighborhood_t *const neighborhood_id
+			   , int type_id
+			   , int idx
+    );
+
+/** Tests for arrived receives in the entire neighborhood.
+ *
+ *  - scans the remote notifications of the type (one GASPI call per buffer)
+ *    and all shared memory notifications in the same pass.
+ *  - converts or unpacks everything that has arrived.
+ *  - returns the list of the neighbors which were received.
+ *
+ *  At most one stage is received per neighbor and call, i.e. 
+ *  every neighbor appears at most once in ready_idx.
+ *
+ *  A receive is outstanding as long as fewer messages have been 
+ *  received from a neighbor than stage. With stage 0 this is the 
+ *  number of messages sent to it (shan_comm_notify_or_write), 
+ *  pipelines which receive before they send pass the expected stage.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param data_segment   - data segment handle
+ * @param type_id        - type index
+ * @param stage          - total number of receives expected from every neighbor,
+ *                         0: as many as were sent
+ * @param ready_idx      - comm indices of received neighbors (size num_neighbors)
+ * @param num_ready      - number of received neighbors, 
+ *                         0 if no receive was outstanding
+ *
+ * @return SHAN_COMM_SUCCESS if num_ready > 0 or nothing is outstanding, -1 otherwise.
+ */
+int shan_comm_testsome(shan_neighborhood_t *const neighborhood_id
+		       , shan_segment_t *data_segment
+		       , int type_id
+		       , int stage
+		       , int *ready_idx
+		       , int *num_ready
+    );
+
+/** Waits for at least one outstanding receive in the neighborhood,
+ *  see shan_comm_testsome. Neighbor boundaries can be processed
+ *  as soon as their halos have arrived.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param data_segment   - data segment handle
+ * @param type_id        - type index
+ * @param stage          - total number of receives expected from every neighbor,
+ *                         0: as many as were sent
+ * @param ready_idx      - comm indices of received neighbors (size num_neighbors)
+ * @param num_ready      - number of received neighbors, 
+ *                         0 if no receive was outstanding
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_waitsome(shan_neighborhood_t *const neighborhood_id
+		       , shan_segment_t *data_segment
+		       , int type_id
+		       , int stage
+		       , int *ready_idx
+		       , int *num_ready
+    );
+
 /** Waits for entire neighborhood
  *  
  *  - waits for all send requests
@@ -330,13 +941,65 @@ int shan_comm_test4Send(shan_neighborhood_t *const neighborhood_id
     ); 
 
 
-/** Shared mem barrier
+/** Shared mem barrier of all node local ranks.
+ *  Sense reversing barrier on shared notifications (no MPI), 
+ *  waits according to the wait policy.
  *  
  * @param neighborhood_id - general neighborhood handle
  *
  */
 void shan_comm_shmemBarrier(shan_neighborhood_t *const neighborhood_id);
 
+
+/** Sends a signal (no data) to a neighbor.
+ *  Signals of a neighbor pair are counted, every signal is 
+ *  received once with shan_comm_wait4Signal/shan_comm_test4Signal.
+ *  
+ * @param neighborhood_id - general neighborhood handle
+ * @param idx            - comm index for target rank in neighborhood
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_signal(shan_neighborhood_t *const neighborhood_id
+		     , int idx
+    );
+
+
+/** Tests for the next signal of a neighbor.
+ *  
+ * @param neighborhood_id - general neighborhood handle
+ * @param idx            - comm index for source rank in neighborhood
+ *
+ * @return SHAN_COMM_SUCCESS if received, -1 otherwise.
+ */
+int shan_comm_test4Signal(shan_neighborhood_t *const neighborhood_id
+			  , int idx
+    );
+
+
+/** Waits for the next signal of a neighbor.
+ *  
+ * @param neighborhood_id - general neighborhood handle
+ * @param idx            - comm index for source rank in neighborhood
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_wait4Signal(shan_neighborhood_t *const neighborhood_id
+			  , int idx
+    );
+
+
+/** Barrier of a rank with its neighbors only.
+ *  Signals all neighbors and waits for a signal of every neighbor
+ *  (shared notifications node locally, GASPI notifications otherwise).
+ *  Requires a symmetric neighborhood.
+ *  
+ * @param neighborhood_id - general neighborhood handle
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_neighborBarrier(shan_neighborhood_t *const neighborhood_id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,168 @@
+/*
+    Copyright (c) T-Systems SfR, C.Simmendinger <christian.simmendinger@t-systems.com>, 2018
+
+    This file is part of SHAN.
+
+    SHAN is free software: you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+	    the Free Software Foundation, either version 3 of the License, or
+	        (at your option) any later version.
+
+    SHAN is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+	    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	        GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+        along with SHAN.  If not, see <https://www.gnu.org/licenses/>.
+	
+*/
+
+
+
+#ifndef SHAN_REDUCE_H
+#define SHAN_REDUCE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "GASPI.h"
+#include "SHAN_segment.h"
+#include "SHAN_comm.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** \file SHAN_reduce.h
+ *  \brief SHAN_reduce header. Hierarchical allreduce.
+ *   
+ *  Node local contributions are combined in shared memory by the 
+ *  node master (local rank 0), masters reduce with GASPI notified 
+ *  writes along a binomial tree, the result is broadcast back along 
+ *  the tree and published in shared memory. 
+ *  A reduction is started with shan_comm_allreduce_start and completed
+ *  with shan_comm_allreduce_test or shan_comm_allreduce_wait, e.g. to 
+ *  overlap a residual check with the next stencil sweep.
+ *  Only one reduction per handle can be in flight.
+ */
+
+/** Reduction operation.
+ */
+enum shan_reduce_op {
+    SHAN_SUM = 0,
+    SHAN_MAX = 1,
+    SHAN_MIN = 2
+};
+
+/** Reduction handle, rank local.
+ */
+typedef struct
+{
+    shan_neighborhood_t *neighborhood; //!< node local ranks, wait policy and GASPI queues
+    int reduce_id;              //!< shared segment id and GASPI segment id
+    int max_count;              //!< max number of elements per reduction
+    shan_segment_t shared_segment; //!< node local contributions and result
+    shan_remote_t remote_segment;  //!< master buffers, GASPI registered
+    int num_master;             //!< number of node masters
+    int iMaster;                //!< own master index, -1 for non-masters
+    int *master_rank;           //!< global rank per master index
+    int epoch;                  //!< number of started reductions
+    int count;                  //!< number of elements of current reduction
+    int op;                     //!< operation of current reduction (shan_reduce_op)
+    double *recvbuf;            //!< result of current reduction
+    int state;                  //!< progress of current reduction
+    int mask;                   //!< current level in the master tree
+} shan_reduce_t;
+
+
+/** Initializes a reduction handle, collective over the neighborhood
+ *  (MPI_COMM_ALL). Requires an initialized neighborhood.
+ *  
+ * @param reduce_id       - reduction handle
+ * @param neighborhood_id - general neighborhood handle
+ * @param segment_id      - shared segment id and GASPI segment id, 
+ *                          must differ from all other SHAN segments
+ * @param max_count       - max number of elements per reduction
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_init_reduce(shan_reduce_t *const reduce_id
+			  , shan_neighborhood_t *const neighborhood_id
+			  , int segment_id
+			  , int max_count
+    );
+
+
+/** Frees a reduction handle, collective. 
+ *  All started reductions must have completed.
+ *  
+ * @param reduce_id - reduction handle
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_free_reduce(shan_reduce_t *const reduce_id);
+
+
+/** Starts an allreduce of count doubles. 
+ *  sendbuf can be reused on return, recvbuf (may be sendbuf) is 
+ *  valid after completion.
+ *  
+ * @param reduce_id - reduction handle
+ * @param sendbuf   - own contribution
+ * @param recvbuf   - result
+ * @param count     - number of elements, at most max_count
+ * @param op        - reduction operation (shan_reduce_op)
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_allreduce_start(shan_reduce_t *const reduce_id
+			      , double const *sendbuf
+			      , double *recvbuf
+			      , int count
+			      , int op
+    );
+
+
+/** Progresses a started allreduce, does not block.
+ *  
+ * @param reduce_id - reduction handle
+ *
+ * @return SHAN_COMM_SUCCESS if complete, -1 otherwise.
+ */
+int shan_comm_allreduce_test(shan_reduce_t *const reduce_id);
+
+
+/** Waits for completion of a started allreduce.
+ *  
+ * @param reduce_id - reduction handle
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_allreduce_wait(shan_reduce_t *const reduce_id);
+
+
+/** Blocking allreduce, start + wait.
+ *  
+ * @param reduce_id - reduction handle
+ * @param sendbuf   - own contribution
+ * @param recvbuf   - result
+ * @param count     - number of elements, at most max_count
+ * @param op        - reduction operation (shan_reduce_op)
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+int shan_comm_allreduce(shan_reduce_t *const reduce_id
+			, double const *sendbuf
+			, double *recvbuf
+			, int count
+			, int op
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
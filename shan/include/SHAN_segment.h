@@ -80,6 +80,7 @@ enum shan_return_val  {
 typedef struct
 {
     volatile int val  __attribute__((aligned(64))); //!< notification value
+    volatile int waiters;        //!< number of ranks blocked on val
 } shan_notification_t;
     
 /** Segment struct, shared, holds all segment information.
@@ -95,6 +96,7 @@ typedef struct
     int shan_type;              //!< shared segment type
     long dataSz;                //!< segment size
     long *localDataSz;          //!< segment size array
+    int gaspi_id;               //!< GASPI segment id, -1 if not registered
     MPI_Comm MPI_COMM_SHM;      //!< MPI shared mem communicator
     
 #ifdef USE_MPI_SHARED_WIN
@@ -126,6 +128,24 @@ int shan_alloc_shared(shan_segment_t *const segment
 		      , const MPI_Comm MPI_COMM_SHM 
 	);
 
+/** Registers the rank local part of shared memory as GASPI segment.
+ *  Contiguous sends from a registered SHAN_DATA segment are 
+ *  written without intermediate copy into a linear send buffer.
+ *  Types can additionally opt in to direct receives into a 
+ *  registered segment (shan_comm_set_direct).
+ *
+ * Note: gaspi_id must not be used by any other GASPI segment 
+ *       (including the neighborhood ids of shan_comm_init_comm).
+ *
+ * @param segment      - segment handle
+ * @param gaspi_id     - (unique) GASPI segment id
+ *
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+int shan_register_shared(shan_segment_t *const segment
+			 , const int gaspi_id
+	);
+
 /** Free shared memory.
  *     
  * @param segment      - segment handle
@@ -165,6 +185,7 @@ int shan_get_shared_ptr(shan_segment_t * const segment
 /** Increments shared mem notfication.
  *  Sets write fence such that local result is valid, 
  *  once the incremented value is visible for other local ranks.
+ *  Wakes up ranks blocked in shan_notify_wait_shared.
  *
  * @param ptr - pointer to shared notification array
  * @param idx - shared mem notification id
@@ -191,6 +212,24 @@ int shan_get_shared_ptr(shan_segment_t * const segment
      );
     
 
+/** Blocks while shared mem notification still has value val.
+ *  Uses a futex on the notification (Linux), woken by 
+ *  shan_notify_increment_shared. Returns at the latest after
+ *  timeout_us, spurious returns are possible.
+ *
+ * @param ptr - pointer to shared notification array
+ * @param idx - shared mem notification id
+ * @param val - notification value to wait on
+ * @param timeout_us - timeout in microseconds
+ * 
+ * @return SHAN_SUCCESS in case of success, SHAN_ERROR in case of error.
+ */
+ int shan_notify_wait_shared(shan_notification_t *const ptr
+			     , const int idx
+			     , const int val
+			     , const long timeout_us
+     );
+
 /** Tests for shared mem notfication.
  *
  * @param ptr - pointer to shared notification array
@@ -56,6 +56,52 @@ void shan_comm_get_local(shan_neighborhood_t *neighborhood_id
 			 , const int idx
     );
 
+/** Finalizes receive in shared mem without type conversion, 
+ *  returns a view of the send data of the neighbor instead.
+ *  The 'have read' notification is left to shan_comm_release_view.
+ * 
+ * @param neighborhood_id - general neighborhood handle
+ * @param data_segment    - used data segment
+ * @param type_id         - used type id
+ * @param idx             - rank index in neighborhood
+ * @param view            - view of the received data
+ */
+void shan_comm_get_view(shan_neighborhood_t *neighborhood_id
+			, shan_segment_t *data_segment
+			, const int type_id
+			, const int idx
+			, shan_view_t *view
+    );
+
+/** Announces that the receive locations for the next 
+ *  receive from a node local neighbor are free (push mode).
+ * 
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - used type id
+ * @param idx             - rank index in neighborhood
+ */
+void shan_comm_recv_ready(shan_neighborhood_t *neighborhood_id
+			  , const int type_id
+			  , const int idx
+    );
+
+/** Converts own send type directly into the recv type 
+ *  of a node local neighbor, if the neighbor has announced 
+ *  the receive (push mode). 
+ * 
+ * @param neighborhood_id - general neighborhood handle
+ * @param data_segment    - used data segment
+ * @param type_id         - used type id
+ * @param idx             - rank index in neighborhood
+ *
+ * @return 1 if data has been pushed, 0 otherwise.
+ */
+int shan_comm_put_local(shan_neighborhood_t *neighborhood_id
+			, shan_segment_t *data_segment
+			, const int type_id
+			, const int idx
+    );
+
 /** Finalizes receive for remote comm
  *
  * @param neighborhood_id - general neighborhood handle
@@ -71,7 +117,10 @@ void shan_comm_get_local(shan_neighborhood_t *neighborhood_id
 			   , int const idx
      );
 
-/** Returns type data structure for node local ranks
+/** Returns type data structure for node local ranks.
+ *  The layout follows the own max sizes, i.e. the type data 
+ *  of node local neighbors is taken from the comm handles 
+ *  (shan_handle_t, remote_type) instead.
  *  
  * @param type_info       - type data struct (SHAN_comm.h)
  * @param neighborhood_id - general neighborhood handle
@@ -98,7 +147,9 @@ void shan_comm_get_local(shan_neighborhood_t *neighborhood_id
  * @param send_sz         - pointer to send size in shared mem
  * @param recv_sz         - pointer to recv size in shared mem
  * @param send_offset     - pointer to offset of send elements in shared mem
+ *                          (NULL for SHAN_OFFSET_BLOCK types)
  * @param recv_offset     - pointer to offset of recv elements in shared mem
+ *                          (NULL for SHAN_OFFSET_BLOCK types)
  *
  * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
  */
@@ -113,19 +164,92 @@ void shan_comm_get_local(shan_neighborhood_t *neighborhood_id
      );
 
 
+/** Gets block type data structure for node local ranks.
+ *  Only valid for types with SHAN_OFFSET_BLOCK format, where
+ *  element offsets are described by base + stride + count blocks
+ *  rather than by one offset per element. nelem_send and nelem_recv
+ *  remain the total number of elements, irregular offsets can be 
+ *  described by blocks of a single element.
+ *  
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - used type id
+ * @param nelem_send      - pointer to number of send elements in shared mem
+ * @param nelem_recv      - pointer to number of recv elements in shared mem
+ * @param send_sz         - pointer to send size in shared mem
+ * @param recv_sz         - pointer to recv size in shared mem
+ * @param nblock_send     - pointer to number of send blocks in shared mem
+ * @param nblock_recv     - pointer to number of recv blocks in shared mem
+ * @param send_block      - pointer to send offset blocks in shared mem
+ * @param recv_block      - pointer to recv offset blocks in shared mem
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+ int shan_comm_type_block(shan_neighborhood_t *neighborhood_id
+			  , int type_id
+			  , int **nelem_send
+			  , int **nelem_recv
+			  , int **send_sz
+			  , int **recv_sz
+			  , int **nblock_send
+			  , int **nblock_recv
+			  , shan_offset_block_t **send_block
+			  , shan_offset_block_t **recv_block
+     );
+
+
+/** Commits type meta data of the local rank.
+ *  Compiles the current element offsets into coalesced copy plans,
+ *  which then replace the element-wise copy in packing, unpacking
+ *  and type conversion.
+ *
+ *  Once committed, any change of the meta data requires a new commit
+ *  before the next communication of this type. Types which are never
+ *  committed are copied element-wise.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - used type id
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+ int shan_comm_type_commit(shan_neighborhood_t *neighborhood_id
+			   , int type_id
+     );
+
+
+/** Prepares the communication handles of a type (SHAN_comm.h).
+ *  Caches the shared type data of the own rank and node local neighbors,
+ *  remote buffer offsets and notification ids. Called once in 
+ *  shan_comm_init_comm, meta data changes go through shan_comm_type_commit.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - used type id
+ *
+ * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
+ */
+ int shan_comm_type_prepare(shan_neighborhood_t *neighborhood_id
+			    , int type_id
+     );
+
+
 /** Getter function for type data
  *  
  * @param type_info       - type data struct (SHAN_comm.h)   
  * @param shm_ptr         - pointer to shared memory 
  * @param num_neighbors   - rank local number of neighbors in neighborhood
- * @param type_element    - type element
+ * @param elemOffset      - element offset of type in shared mem (per neighbor)
+ * @param max_nelem_send  - max number of send elements of the owning rank
+ * @param max_nelem_recv  - max number of recv elements of the owning rank
+ * @param offset_format   - offset descriptor format of type
  *
  * @return SHAN_COMM_SUCCESS in case of success, SHAN_COMM_ERROR in case of error.
  */
  int shan_comm_get_type(type_local_t *type_info
 			, void *shm_ptr
 			, int num_neighbors
-			, shan_element_t *type_element
+			, long elemOffset
+			, int max_nelem_send
+			, int max_nelem_recv
+			, int offset_format
      );
 
 
@@ -31,6 +31,7 @@
 #include "SHAN_segment.h"
 #include "SHAN_comm.h"
 #include "SHAN_type.h"
+#include "SHAN_reduce.h"
 #include "F_SHAN.h"
 
 #include "assert.h"
@@ -38,9 +39,11 @@
  
 #define MAX_NEIGHBOR_HOOD 32
 #define MAX_SEGMENT 32
+#define MAX_REDUCE 8
 
 static shan_neighborhood_t neighbor_hood[MAX_NEIGHBOR_HOOD];
 static shan_segment_t data_segment[MAX_SEGMENT];
+static shan_reduce_t reduce[MAX_REDUCE];
 
 
 void f_shan_alloc_shared(const int segment_id
@@ -75,6 +78,19 @@ void f_shan_alloc_shared(const int segment_id
 }
 
 
+void f_shan_register_shared(const int segment_id
+			    , const int gaspi_id
+			    )
+{
+  int res;
+  shan_segment_t *dataSegment  = &data_segment[segment_id];
+  res = shan_register_shared(dataSegment
+			     , gaspi_id
+			     );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+
 void f_shan_free_shared(const int segment_id)
 {
   int res;
@@ -97,6 +113,126 @@ void f_shan_free_comm(const int neighbor_hood_id)
     
 }
 
+
+void f_shan_set_wait_policy(const int neighbor_hood_id
+			    , const int wait_policy
+			    , const int spin_count
+			    )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_set_wait_policy(ngbSegment
+				      , wait_policy
+				      , spin_count
+				      );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+
+void f_shan_set_queues(const int neighbor_hood_id
+		       , const int num_queue
+		       , const int queue_affinity
+		       )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_set_queues(ngbSegment
+				 , num_queue
+				 , queue_affinity
+				 );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+void f_shan_set_coalescing(const int neighbor_hood_id
+			   , const int enable
+			   )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_set_coalescing(ngbSegment
+				     , enable
+				     );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+void f_shan_set_stream_threshold(const int neighbor_hood_id
+				 , const int type_id
+				 , const long threshold
+				 )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_set_stream_threshold(ngbSegment
+					   , type_id
+					   , threshold
+					   );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+void f_shan_set_push(const int neighbor_hood_id
+		     , const int type_id
+		     , const int enable
+		     )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_set_push(ngbSegment
+			       , type_id
+			       , enable
+			       );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+void f_shan_set_pull(const int neighbor_hood_id
+		     , const int type_id
+		     , const int enable
+		     )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_set_pull(ngbSegment
+			       , type_id
+			       , enable
+			       );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+void f_shan_set_direct(const int neighbor_hood_id
+		       , const int type_id
+		       , const int segment_id
+		       , const int enable
+		       )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  shan_segment_t *dataSegment = &data_segment[segment_id];
+  int res = shan_comm_set_direct(ngbSegment
+				 , type_id
+				 , dataSegment
+				 , enable
+				 );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+void f_shan_set_stats_dump(const int neighbor_hood_id
+			   , const int enable
+			   )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_set_stats_dump(ngbSegment
+				     , enable
+				     );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
+void f_shan_set_unpack_team(const int neighbor_hood_id
+			    , const int num_thread
+			    , const long cutoff
+			    )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_set_unpack_team(ngbSegment
+				      , num_thread
+				      , cutoff
+				      , NULL
+				      , NULL
+				      );
+  ASSERT(res == SHAN_SUCCESS);
+}
+
 void f_shan_init_comm(const int neighbor_hood_id
 		      , void *neighbors
 		      , int num_neighbors
@@ -127,6 +263,8 @@ void f_shan_init_comm(const int neighbor_hood_id
 			    , (long*) maxRecvSz			    
 			    , (int*) max_nelem_send
 			    , (int*) max_nelem_recv
+			    , NULL
+			    , NULL
 			    , num_type
 			    , MPI_COMM_SHM
 			    , MPI_COMM_WORLD
@@ -134,6 +272,28 @@ void f_shan_init_comm(const int neighbor_hood_id
   ASSERT(res == SHAN_SUCCESS);  
 }
 
+void f_shan_update_comm(const int neighbor_hood_id
+			, void *neighbors
+			, int num_neighbors
+			, void *maxSendSz
+			, void *maxRecvSz
+			, void *max_nelem_send
+			, void *max_nelem_recv
+			)
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+
+  int res = shan_comm_update_comm(ngbSegment
+				  , (int*) neighbors
+				  , num_neighbors
+				  , (long*) maxSendSz
+				  , (long*) maxRecvSz			    
+				  , (int*) max_nelem_send
+				  , (int*) max_nelem_recv
+				  );  
+  ASSERT(res == SHAN_SUCCESS);  
+}
+
 void f_shan_type_offset(const int neighbor_hood_id
 			, const int type_id
 			, void **nelem_send
@@ -157,6 +317,17 @@ void f_shan_type_offset(const int neighbor_hood_id
   ASSERT(res == SHAN_SUCCESS);  
 }
 
+void f_shan_type_commit(const int neighbor_hood_id
+			, const int type_id
+			)
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  int res = shan_comm_type_commit(ngbSegment
+				  , type_id
+				  );
+  ASSERT(res == SHAN_SUCCESS);  
+}
+
 
 void f_shan_comm_wait4All(const int neighbor_hood_id  
 			  , const int segment_id
@@ -188,6 +359,15 @@ void f_shan_comm_wait4AllSend(const int neighbor_hood_id
 }
 
 
+void f_shan_comm_neighborBarrier(const int neighbor_hood_id)
+{
+    shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+    
+    int res = shan_comm_neighborBarrier(ngbSegment);
+    ASSERT(res == SHAN_SUCCESS);
+}
+
+
 void f_shan_comm_wait4AllRecv(const int neighbor_hood_id  
 			      , const int segment_id
 			      , const int type_id
@@ -204,6 +384,28 @@ void f_shan_comm_wait4AllRecv(const int neighbor_hood_id
 }
 
 
+void f_shan_comm_waitsome(const int neighbor_hood_id  
+			  , const int segment_id
+			  , const int type_id
+			  , const int stage
+			  , int *ready_idx
+			  , int *num_ready
+    )
+{
+    shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+    shan_segment_t *dataSegment  = &data_segment[segment_id];
+    
+    int res = shan_comm_waitsome(ngbSegment
+				 , dataSegment
+				 , type_id
+				 , stage
+				 , ready_idx
+				 , num_ready
+	);
+    ASSERT(res == SHAN_SUCCESS);
+}
+
+
 void f_shan_comm_notify_or_write(const int neighbor_hood_id
 				 , const int segment_id
 				 , const int type_id
@@ -223,5 +425,88 @@ void f_shan_comm_notify_or_write(const int neighbor_hood_id
 }
 
 
+void f_shan_comm_notify_or_write_multi(const int neighbor_hood_id
+				       , const int segment_id
+				       , int *type_ids
+				       , const int num_type_ids
+				       , int idx
+    )
+{
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
+  shan_segment_t *dataSegment  = &data_segment[segment_id];
+
+  int res = shan_comm_notify_or_write_multi(ngbSegment
+					    , dataSegment
+					    , type_ids
+					    , num_type_ids
+					    , idx
+      );
+  ASSERT(res == SHAN_SUCCESS);  
+  
+}
+
+
+void f_shan_init_reduce(const int reduce_id
+			, const int neighbor_hood_id
+			, const int segment_id
+			, const int max_count
+    )
+{
+  ASSERT(reduce_id >= 0 && reduce_id < MAX_REDUCE);
+  shan_neighborhood_t *ngbSegment = &neighbor_hood[neighbor_hood_id];
 
+  int res = shan_comm_init_reduce(&reduce[reduce_id]
+				  , ngbSegment
+				  , segment_id
+				  , max_count
+      );
+  ASSERT(res == SHAN_SUCCESS);  
+}
+
+
+void f_shan_free_reduce(const int reduce_id)
+{
+  int res = shan_comm_free_reduce(&reduce[reduce_id]);
+  ASSERT(res == SHAN_SUCCESS);  
+}
 
+
+void f_shan_allreduce(const int reduce_id
+		      , double *sendbuf
+		      , double *recvbuf
+		      , const int count
+		      , const int op
+    )
+{
+  int res = shan_comm_allreduce(&reduce[reduce_id]
+				, sendbuf
+				, recvbuf
+				, count
+				, op
+      );
+  ASSERT(res == SHAN_SUCCESS);  
+}
+
+
+void f_shan_allreduce_start(const int reduce_id
+			    , double *sendbuf
+			    , double *recvbuf
+			    , const int count
+			    , const int op
+    )
+{
+  int res = shan_comm_allreduce_start(&reduce[reduce_id]
+				      , sendbuf
+				      , recvbuf
+				      , count
+				      , op
+      );
+  ASSERT(res == SHAN_SUCCESS);  
+}
+
+
+void f_shan_allreduce_wait(const int reduce_id)
+{
+  int res = shan_comm_allreduce_wait(&reduce[reduce_id]);
+  ASSERT(res == SHAN_SUCCESS);  
+}
@@ -24,6 +24,20 @@
 
 #include "GASPI.h"
 
+#ifndef USE_NOCOS
+#define GASPI_PROC_LOCAL 0
+#endif
+
+void 
+write_and_wait ( gaspi_segment_id_t segment_id_local
+		 , gaspi_offset_t const offset_local
+		 , gaspi_rank_t const rank
+		 , gaspi_segment_id_t segment_id_remote
+		 , gaspi_offset_t const offset_remote
+		 , gaspi_size_t const size
+		 , gaspi_queue_id_t const queue
+		 );
+
 void 
 write_notify_and_wait ( gaspi_segment_id_t segment_id
 			, gaspi_offset_t const offset_local
@@ -35,4 +49,39 @@ write_notify_and_wait ( gaspi_segment_id_t segment_id
 			, gaspi_queue_id_t const queue
 			);
 
+void 
+read_notify_and_wait ( gaspi_segment_id_t segment_id
+		       , gaspi_offset_t const offset_local
+		       , gaspi_rank_t const rank
+		       , gaspi_offset_t const offset_remote
+		       , gaspi_size_t const size
+		       , gaspi_notification_id_t const notification_id
+		       , gaspi_queue_id_t const queue
+		       );
+
+void 
+write_list_notify_and_wait ( gaspi_number_t const num
+			     , gaspi_segment_id_t *const segment_id_local
+			     , gaspi_offset_t *const offset_local
+			     , gaspi_rank_t const rank
+			     , gaspi_segment_id_t *const segment_id_remote
+			     , gaspi_offset_t *const offset_remote
+			     , gaspi_size_t *const size
+			     , gaspi_segment_id_t const segment_id_notification
+			     , gaspi_notification_id_t const notification_id
+			     , gaspi_notification_t const notification_value
+			     , gaspi_queue_id_t const queue
+			     );
+
+void 
+write_list_and_wait ( gaspi_number_t const num
+		      , gaspi_segment_id_t *const segment_id_local
+		      , gaspi_offset_t *const offset_local
+		      , gaspi_rank_t const rank
+		      , gaspi_segment_id_t *const segment_id_remote
+		      , gaspi_offset_t *const offset_remote
+		      , gaspi_size_t *const size
+		      , gaspi_queue_id_t const queue
+		      );
+
 #endif
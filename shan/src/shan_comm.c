@@ -35,16 +35,273 @@
 #include "SHAN_comm.h"
 #include "SHAN_type.h"
 
-#include "shan_exchange.h"
 #include "gaspi_util.h"
 #include "shan_core.h"
 #include "shan_util.h"
 #include "assert.h"
 
 
+/*
+ * receive from neighbor idx outstanding, stage: number of receives 
+ * expected from every neighbor (0: as many as were sent)
+ */
+static int shan_comm_recv_outstanding(shan_element_t const *const type_element
+				      , int const idx
+				      , int const stage
+    )
+{
+    int const expected = (stage > 0) ? stage 
+	: type_element->local_send_count[idx];
+    return type_element->local_recv_count[idx] < expected;
+}
+
+
+/*
+ * neighbor to block on in multi waits, node local neighbors first.
+ * done: per neighbor flag (NULL: outstanding receives up to stage)
+ */
+static int shan_comm_first_pending(shan_neighborhood_t *const neighborhood_id
+				   , int const type_id
+				   , int const *const done
+				   , int const stage
+    )
+{
+    int i, idx = -1;
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    for (i = 0; i < neighborhood_id->num_neighbors; ++i)
+    {
+	int const pending = (done != NULL) ? !done[i] 
+	    : shan_comm_recv_outstanding(type_element, i, stage);
+	if (pending)
+	{
+	    if (type_element->handle[i].local_rank != -1)
+	    {
+		return i;
+	    }
+	    idx = (idx == -1) ? i : idx;
+	}
+    }
+    return idx;
+}
+
+
+/*
+ * shared sync notifications of a node local rank 
+ */
+static shan_notification_t *shan_comm_sync(shan_neighborhood_t *const neighborhood_id
+					   , int const local_rank
+    )
+{
+    void *shm_ptr;
+    shan_get_shared_ptr(&(neighborhood_id->shared_segment)
+			, local_rank
+			, &shm_ptr);
+    return (shan_notification_t *) shm_ptr;
+}
+
+
 void shan_comm_shmemBarrier(shan_neighborhood_t *const neighborhood_id)
 {
-    MPI_Barrier(neighborhood_id->MPI_COMM_SHM);
+    shan_notification_t *const sync = shan_comm_sync(neighborhood_id, 0);
+
+    /*
+     * the sense is the barrier generation, it only changes 
+     * once all ranks (incl. us) have arrived
+     */
+    int gen = -1;
+    shan_notify_test_shared(sync
+			    , SHAN_SYNC_BARRIER_GEN
+			    , &gen
+	);
+
+    if (__sync_add_and_fetch(&(sync[SHAN_SYNC_BARRIER_COUNT].val), 1) 
+	== neighborhood_id->nProcLocal)
+    {
+	sync[SHAN_SYNC_BARRIER_COUNT].val = 0;
+	shan_notify_increment_shared(sync
+				     , SHAN_SYNC_BARRIER_GEN
+				     , 1
+	    );
+	return;
+    }
+
+    int iter = 0;
+    int rval = gen;
+    while (rval == gen)
+    {
+	shan_comm_backoff_shared(neighborhood_id
+				 , sync
+				 , SHAN_SYNC_BARRIER_GEN
+				 , gen
+				 , &iter
+	    );
+	shan_notify_test_shared(sync
+				, SHAN_SYNC_BARRIER_GEN
+				, &rval
+	    );
+    }
+}
+
+
+int shan_comm_signal(shan_neighborhood_t *const neighborhood_id
+		     , int idx
+    )
+{
+    ASSERT(idx >= 0);
+    ASSERT(idx < neighborhood_id->num_neighbors);
+
+    int const count = ++(neighborhood_id->signal_send_count[idx]);
+    if (neighborhood_id->local_rank[idx] != -1)
+    {
+	shan_notify_increment_shared(shan_comm_sync(neighborhood_id
+						    , neighborhood_id->iProcLocal)
+				     , SHAN_SYNC_SIGNAL + idx
+				     , 1
+	    );
+    }
+    else
+    {
+	int const num_type = neighborhood_id->num_type;
+	int const nid = GET_SIGNAL_NOTIFICATION_ID(neighborhood_id->num_buffer_max
+						   , num_type
+						   , neighborhood_id->RemoteNumNeighbors[idx]
+						   , neighborhood_id->RemoteCommIndex[idx]);
+	gaspi_queue_id_t queue = shan_comm_queue(neighborhood_id, 0, idx);
+	shan_comm_queue_reserve(neighborhood_id
+				, &queue
+				, 1
+	    );
+	SUCCESS_OR_DIE(gaspi_notify (neighborhood_id->remote_segment.shan_id
+				     , neighborhood_id->neighbors[idx]
+				     , (gaspi_notification_id_t) nid
+				     , (gaspi_notification_t) count
+				     , queue
+				     , GASPI_BLOCK
+			   ));
+    }
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_test4Signal(shan_neighborhood_t *const neighborhood_id
+			  , int idx
+    )
+{
+    ASSERT(idx >= 0);
+    ASSERT(idx < neighborhood_id->num_neighbors);
+
+    int const recv_count = neighborhood_id->signal_recv_count[idx];
+    if (neighborhood_id->local_rank[idx] != -1)
+    {
+	int rval = -1;
+	shan_notify_test_shared(shan_comm_sync(neighborhood_id
+					       , neighborhood_id->local_rank[idx])
+				, SHAN_SYNC_SIGNAL + neighborhood_id->RemoteCommIndex[idx]
+				, &rval
+	    );
+	if (rval > recv_count)
+	{
+	    ++(neighborhood_id->signal_recv_count[idx]);
+	    return SHAN_SUCCESS;
+	}
+	return -1;
+    }
+
+    /*
+     * notification values are signal counts, a newer signal 
+     * may have overwritten an unconsumed one
+     */
+    if (neighborhood_id->signal_seen[idx] == recv_count)
+    {
+	shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+	int const nid = GET_SIGNAL_NOTIFICATION_ID(neighborhood_id->num_buffer_max
+						   , neighborhood_id->num_type
+						   , neighborhood_id->num_neighbors
+						   , idx);
+	gaspi_notification_id_t tmp_id;
+	gaspi_notification_t nval;
+	gaspi_return_t ret;
+	if ((ret = gaspi_notify_waitsome (remote_segment->shan_id
+					  , (gaspi_notification_id_t) nid
+					  , 1
+					  , &tmp_id
+					  , GASPI_TEST
+		 )) == GASPI_SUCCESS)
+	{
+	    SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
+					       , tmp_id
+					       , &nval
+			       ));
+	    neighborhood_id->signal_seen[idx] 
+		= MAX(neighborhood_id->signal_seen[idx], (int) nval);
+	}
+	else
+	{
+	    ASSERT (ret != GASPI_ERROR);
+	}
+    }
+
+    if (neighborhood_id->signal_seen[idx] > recv_count)
+    {
+	++(neighborhood_id->signal_recv_count[idx]);
+	return SHAN_SUCCESS;
+    }
+    return -1;
+}
+
+
+int shan_comm_wait4Signal(shan_neighborhood_t *const neighborhood_id
+			  , int idx
+    )
+{
+    int iter = 0;
+    while (shan_comm_test4Signal(neighborhood_id
+				 , idx
+	       ) == -1)
+    {
+	if (neighborhood_id->local_rank[idx] != -1)
+	{
+	    shan_comm_backoff_shared(neighborhood_id
+				     , shan_comm_sync(neighborhood_id
+						      , neighborhood_id->local_rank[idx])
+				     , SHAN_SYNC_SIGNAL + neighborhood_id->RemoteCommIndex[idx]
+				     , neighborhood_id->signal_recv_count[idx]
+				     , &iter
+		);
+	}
+	else
+	{
+	    shan_comm_backoff(neighborhood_id
+			      , 0
+			      , -1
+			      , 0
+			      , &iter
+		);
+	}
+    }
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_neighborBarrier(shan_neighborhood_t *const neighborhood_id)
+{
+    int i;
+    for (i = 0; i < neighborhood_id->num_neighbors; ++i)
+    {
+	shan_comm_signal(neighborhood_id
+			 , i
+	    );
+    }
+    for (i = 0; i < neighborhood_id->num_neighbors; ++i)
+    {
+	shan_comm_wait4Signal(neighborhood_id
+			      , i
+	    );
+    }
+
+    return SHAN_SUCCESS;
 }
 
 
@@ -53,23 +310,37 @@ int shan_comm_test4Send(shan_neighborhood_t *const neighborhood_id
 			, int idx
 			) 
 {  
-    int const rank = neighborhood_id->neighbors[idx];
     volatile int ack_count 
 	= neighborhood_id->type_element[type_id].local_ack_count[idx];  
 
-    int iProcRemote, id = -1;
-    if ((iProcRemote = shan_comm_local_rank(neighborhood_id
-					    , rank
-	     )) != -1)
-    
+    int id = -1;
+    if (neighborhood_id->type_element[type_id].handle[idx].local_rank != -1)
     {
+	/*
+	 * pushed sends are complete
+	 */
+	if (neighborhood_id->type_element[type_id].local_type.push_count[idx] 
+	    == ack_count + 1)
+	{
+	    ++(neighborhood_id->type_element[type_id].local_ack_count[idx]);
+	    return SHAN_SUCCESS;
+	}
+
+	if (!shan_mailbox_test(neighborhood_id
+			       , type_id
+			       , idx
+			       , SHAN_MAILBOX_ACK
+		))
+	{
+	    return -1;
+	}
+
 	int rval = -1;
 	int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
 	int const RemoteNumNeighbors = neighborhood_id->RemoteNumNeighbors[idx];
 	shan_test_shared(neighborhood_id
-			 , iProcRemote
-			 , RemoteNumNeighbors
 			 , type_id
+			 , idx
 			 , RemoteNumNeighbors + RemoteCommIdx
 			 , &rval
 	    );		  
@@ -80,12 +351,43 @@ int shan_comm_test4Send(shan_neighborhood_t *const neighborhood_id
 	    ++(neighborhood_id->type_element[type_id].local_ack_count[idx]);
 	    id = idx;
 	}
+	else
+	{
+	    shan_mailbox_clear(neighborhood_id
+			       , type_id
+			       , idx
+			       , SHAN_MAILBOX_ACK
+		);
+	}
     }
     else
     {
-	if (neighborhood_id->type_element[type_id].local_recv_count[idx] > 
-	    neighborhood_id->type_element[type_id].local_ack_count[idx])
+	/*
+	 * a receive from the neighbor implies that it is done with our previous 
+	 * send, a ring of num_buffer buffers allows for num_buffer-2 more.
+	 */
+	shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+	int const recv_count = type_element->local_recv_count[idx];
+	if (recv_count > ack_count
+	    || (recv_count + type_element->num_buffer - 2 > ack_count
+		&& type_element->local_send_count[idx] > ack_count))
 	{	
+	    /*
+	     * zero copy sends read from the data segment, 
+	     * which requires local completion (of the queue used, + 1).
+	     */
+	    int *const pending = neighborhood_id->type_element[type_id].zero_copy_pending;
+	    if (pending[idx])
+	    {
+		gaspi_return_t ret;
+		gaspi_queue_id_t const queue = (gaspi_queue_id_t) (pending[idx] - 1);
+		if ((ret = gaspi_wait(queue, GASPI_TEST)) != GASPI_SUCCESS)
+		{
+		    ASSERT(ret != GASPI_ERROR);
+		    return -1;
+		}
+		pending[idx] = 0;
+	    }
 	    ++(neighborhood_id->type_element[type_id].local_ack_count[idx]);
 	    id = idx;
 	}
@@ -101,31 +403,40 @@ int shan_comm_wait4Send(shan_neighborhood_t *const neighborhood_id
 			, int idx
 			) 
 {  
-    int res = -1;
+    int res = -1, iter = 0;
+    SHAN_STATS_TIME(t0);
     while ((res = shan_comm_test4Send(neighborhood_id
 				      , type_id
 				      , idx
 		)) == -1)
     {	      
-	_mm_pause();
+	shan_comm_backoff(neighborhood_id
+			  , type_id
+			  , idx
+			  , 1
+			  , &iter
+	    );
     }	      
+    SHAN_STATS_ADD(neighborhood_id, type_id, idx, wait_send, MPI_Wtime() - t0);
 
     return SHAN_SUCCESS;
 }
 
 
 
-int shan_comm_test4Recv(shan_neighborhood_t *const neighborhood_id
-			, shan_segment_t *data_segment
-			, int type_id
-			, int idx
-			) 
+/*
+ * receive from a neighbor, notified: the remote notification 
+ * was already found by a range scan (testsome)
+ */
+static int shan_comm_recv(shan_neighborhood_t *const neighborhood_id
+			  , shan_segment_t *data_segment
+			  , int const type_id
+			  , int const idx
+			  , int const notified
+    ) 
 {
     int id = -1;
-    int const rank = neighborhood_id->neighbors[idx];
-    if (shan_comm_local_rank(neighborhood_id
-			     , rank
-	    ) != -1)
+    if (neighborhood_id->type_element[type_id].handle[idx].local_rank != -1)
     {
 	int res;
 	if ((res = shan_comm_waitsome_local(neighborhood_id
@@ -147,6 +458,7 @@ int shan_comm_test4Recv(shan_neighborhood_t *const neighborhood_id
 	if ((res = shan_comm_waitsome_remote(neighborhood_id
 					     , type_id
 					     , idx
+					     , notified
 		 )) != -1)
 	{
 	    shan_comm_get_remote(neighborhood_id
@@ -157,11 +469,115 @@ int shan_comm_test4Recv(shan_neighborhood_t *const neighborhood_id
 	    id = idx;
 	}
     }
+
+#ifdef USE_SHAN_STATS
+    if (id != -1)
+    {
+	type_local_t const *const type_info 
+	    = &(neighborhood_id->type_element[type_id].local_type);
+	SHAN_STATS_ADD(neighborhood_id, type_id, idx, num_recv, 1);
+	SHAN_STATS_ADD(neighborhood_id, type_id, idx, bytes_recv
+		       , (long) type_info->nelem_recv[idx] * type_info->recv_sz[idx]);
+    }
+#endif
   
     return (id == -1) ? -1 : SHAN_SUCCESS;
 }
 
 
+int shan_comm_test4Recv(shan_neighborhood_t *const neighborhood_id
+			, shan_segment_t *data_segment
+			, int type_id
+			, int idx
+			) 
+{
+    return shan_comm_recv(neighborhood_id
+			  , data_segment
+			  , type_id
+			  , idx
+			  , 0
+	);
+}
+
+
+
+int shan_comm_test4View(shan_neighborhood_t *const neighborhood_id
+			, shan_segment_t *data_segment
+			, int type_id
+			, int idx
+			, shan_view_t *view
+			) 
+{
+    ASSERT(neighborhood_id->type_element[type_id].handle[idx].local_rank != -1);
+    if (shan_comm_waitsome_local(neighborhood_id
+				 , type_id
+				 , idx
+	    ) == -1)
+    {
+	return -1;
+    }
+
+    shan_comm_get_view(neighborhood_id
+		       , data_segment
+		       , type_id
+		       , idx
+		       , view
+	);
+    SHAN_STATS_ADD(neighborhood_id, type_id, idx, num_recv, 1);
+    SHAN_STATS_ADD(neighborhood_id, type_id, idx, bytes_recv
+		   , (long) view->nelem * view->elem_sz);
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_wait4View(shan_neighborhood_t *const neighborhood_id
+			, shan_segment_t *data_segment
+			, int type_id
+			, int idx
+			, shan_view_t *view
+			) 
+{  
+    int iter = 0;
+    SHAN_STATS_TIME(t0);
+    while (shan_comm_test4View(neighborhood_id
+			       , data_segment
+			       , type_id
+			       , idx
+			       , view
+	       ) == -1)
+    {	      
+	shan_comm_backoff(neighborhood_id
+			  , type_id
+			  , idx
+			  , 0
+			  , &iter
+	    );
+    }	      
+    SHAN_STATS_ADD(neighborhood_id, type_id, idx, wait_recv, MPI_Wtime() - t0);
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_release_view(shan_neighborhood_t *const neighborhood_id
+			   , int type_id
+			   , int idx
+    )
+{
+    ASSERT(neighborhood_id->type_element[type_id].handle[idx].local_rank != -1);
+
+    /*
+     * 'have read', completes the send of the neighbor
+     */
+    shan_increment_local(neighborhood_id
+			 , type_id
+			 , neighborhood_id->num_neighbors + idx
+	);
+
+    return SHAN_SUCCESS;
+}
+
 
 int shan_comm_wait4Recv(shan_neighborhood_t *const neighborhood_id
 			, shan_segment_t *data_segment
@@ -169,38 +585,215 @@ int shan_comm_wait4Recv(shan_neighborhood_t *const neighborhood_id
 			, int idx
 			) 
 {  
-    int res = -1;
+    int res = -1, iter = 0;
+    SHAN_STATS_TIME(t0);
     while ((res = shan_comm_test4Recv(neighborhood_id
 				      , data_segment
 				      , type_id
 				      , idx
 		)) == -1)
     {	      
-	_mm_pause();
+	shan_comm_backoff(neighborhood_id
+			  , type_id
+			  , idx
+			  , 0
+			  , &iter
+	    );
     }	      
+    SHAN_STATS_ADD(neighborhood_id, type_id, idx, wait_recv, MPI_Wtime() - t0);
 
     return SHAN_SUCCESS;
 }
 
 
 
+/*
+ * testsome receives at most one stage per neighbor, a later stage 
+ * would overwrite the receive before the caller has processed it
+ */
+static int shan_comm_is_ready(int const *const ready_idx
+			      , int const num_ready
+			      , int const idx
+    )
+{
+    int i;
+    for (i = 0; i < num_ready; ++i)
+    {
+	if (ready_idx[i] == idx)
+	{
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+
+int shan_comm_testsome(shan_neighborhood_t *const neighborhood_id
+		       , shan_segment_t *data_segment
+		       , int type_id
+		       , int stage
+		       , int *ready_idx
+		       , int *num_ready
+		       ) 
+{
+    int i, sid, num = 0, num_outstanding = 0;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type      = neighborhood_id->num_type;
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+
+    /*
+     * shared memory notifications, a single read of the
+     * own mailbox covers all node local neighbors
+     */
+    if (neighborhood_id->num_local > 0)
+    {
+	shan_mailbox_fetch(neighborhood_id
+			   , type_id
+			   , SHAN_MAILBOX_RECV
+	    );
+    }
+    for (i = 0; i < num_neighbors; ++i)
+    {
+	if (shan_comm_recv_outstanding(type_element, i, stage))
+	{
+	    num_outstanding++;
+	    if (type_element->handle[i].local_rank != -1)
+	    {
+		if (shan_comm_test4Recv(neighborhood_id
+					, data_segment
+					, type_id
+					, i
+			) != -1)
+		{
+		    ready_idx[num++] = i;
+		}
+	    }
+	}
+    }
+
+    /*
+     * remote notifications, contiguous range per buffer
+     */
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+    for (sid = 0; sid < type_element->num_buffer && num_outstanding > num; ++sid)
+    {
+	int const first_nid = GET_NOTIFICATION_ID(sid, num_type, type_id, num_neighbors, 0);
+	int start = 0;
+	while (start < num_neighbors)
+	{
+	    gaspi_notification_id_t nid;
+	    gaspi_return_t ret;
+	    if ((ret = gaspi_notify_waitsome (remote_segment->shan_id
+					      , (gaspi_notification_id_t) (first_nid + start)
+					      , (gaspi_number_t) (num_neighbors - start)
+					      , &nid
+					      , GASPI_TEST
+		     )) != GASPI_SUCCESS)
+	    {
+		ASSERT (ret != GASPI_ERROR);
+		break;
+	    }
+
+	    /* 
+	     * next message in other buffer might already be there,
+	     * the notification found here is not tested again
+	     */
+	    int const idx = (int) nid - first_nid;
+	    if (shan_comm_recv_outstanding(type_element, idx, stage)
+		&& type_element->local_recv_count[idx] % type_element->num_buffer == sid
+		&& !shan_comm_is_ready(ready_idx, num, idx))
+	    {
+		if (shan_comm_recv(neighborhood_id
+				   , data_segment
+				   , type_id
+				   , idx
+				   , 1
+			) != -1)
+		{
+		    ready_idx[num++] = idx;
+		}
+	    }
+	    start = idx + 1;
+	}
+    }
+
+    /*
+     * coalesced writes and posted reads (pull mode), dispatched per neighbor
+     */
+    if (neighborhood_id->coalesce || type_element->pull)
+    {
+	for (i = 0; i < num_neighbors && num_outstanding > num; ++i)
+	{
+	    if (shan_comm_recv_outstanding(type_element, i, stage)
+		&& type_element->handle[i].local_rank == -1
+		&& !shan_comm_is_ready(ready_idx, num, i))
+	    {
+		if (shan_comm_test4Recv(neighborhood_id
+					, data_segment
+					, type_id
+					, i
+			) != -1)
+		{
+		    ready_idx[num++] = i;
+		}
+	    }
+	}
+    }
+
+    *num_ready = num;
+  
+    return (num > 0 || num_outstanding == 0) ? SHAN_SUCCESS : -1;
+}
+
+
+int shan_comm_waitsome(shan_neighborhood_t *const neighborhood_id
+		       , shan_segment_t *data_segment
+		       , int type_id
+		       , int stage
+		       , int *ready_idx
+		       , int *num_ready
+		       ) 
+{
+    int res = -1, iter = 0;
+    while ((res = shan_comm_testsome(neighborhood_id
+				     , data_segment
+				     , type_id
+				     , stage
+				     , ready_idx
+				     , num_ready
+		)) == -1)
+    {	      
+	shan_comm_backoff(neighborhood_id
+			  , type_id
+			  , shan_comm_first_pending(neighborhood_id, type_id, NULL, stage)
+			  , 0
+			  , &iter
+	    );
+    }	      
+
+    return SHAN_SUCCESS;
+}
+
+
 
 int shan_comm_wait4AllSend(shan_neighborhood_t *const neighborhood_id
 			   , int type_id
     ) 
 {
-    int i, num_buff = 0;    
+    int i, num_buff = 0, iter = 0;    
     int const num_neighbors  = neighborhood_id->num_neighbors;
+    int *const stage_count = neighborhood_id->type_element[type_id].local_stage_count;
     for (i = 0; i < num_neighbors; ++i)
     {
-	neighborhood_id->local_stage_count[i] = 0;
+	stage_count[i] = 0;
     }
 
     while (num_buff < num_neighbors)
     {
+	int const num_prev = num_buff;
 	for (i = 0; i < num_neighbors; ++i)
 	{
-	    if (!neighborhood_id->local_stage_count[i])
+	    if (!stage_count[i])
 	    {
 		int res;
 		if ((res = shan_comm_test4Send(neighborhood_id
@@ -208,11 +801,24 @@ int shan_comm_wait4AllSend(shan_neighborhood_t *const neighborhood_id
 					       , i
 			 )) != -1)
 		{	
-		    neighborhood_id->local_stage_count[i] = 1;
+		    stage_count[i] = 1;
 		    num_buff++;
 		}
 	    }
 	}
+
+	if (num_buff == num_prev)
+	{
+	    shan_comm_backoff(neighborhood_id
+			      , type_id
+			      , shan_comm_first_pending(neighborhood_id
+							, type_id
+							, stage_count
+							, 0)
+			      , 1
+			      , &iter
+		);
+	}
     }
   
     return SHAN_SUCCESS;
@@ -225,18 +831,20 @@ int shan_comm_wait4AllRecv(shan_neighborhood_t *const neighborhood_id
 			   , int type_id
     )
 {
-    int i, num_recv = 0;    
+    int i, num_recv = 0, iter = 0;    
     int const num_neighbors  = neighborhood_id->num_neighbors;
+    int *const stage_count = neighborhood_id->type_element[type_id].local_stage_count;
     for (i = 0; i < num_neighbors; ++i)
     {
-	neighborhood_id->local_stage_count[i] = 0;
+	stage_count[i] = 0;
     }
 
     while (num_recv < num_neighbors)
     {
+	int const num_prev = num_recv;
 	for (i = 0; i < num_neighbors; ++i)
 	{
-	    if (!neighborhood_id->local_stage_count[i])
+	    if (!stage_count[i])
 	    {
 		int res;
 		if ((res = shan_comm_test4Recv(neighborhood_id
@@ -245,11 +853,24 @@ int shan_comm_wait4AllRecv(shan_neighborhood_t *const neighborhood_id
 					       , i
 			 )) != -1)
 		{
-		    neighborhood_id->local_stage_count[i] = 1;
+		    stage_count[i] = 1;
 		    num_recv++;
 		}
 	    }
 	}
+
+	if (num_recv == num_prev)
+	{
+	    shan_comm_backoff(neighborhood_id
+			      , type_id
+			      , shan_comm_first_pending(neighborhood_id
+							, type_id
+							, stage_count
+							, 0)
+			      , 0
+			      , &iter
+		);
+	}
     }
   
     return SHAN_SUCCESS;
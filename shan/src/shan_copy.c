@@ -0,0 +1,748 @@
+/*
+    Copyright (c) T-Systems SfR, C.Simmendinger <christian.simmendinger@t-systems.com>, 2018
+
+    This file is part of SHAN.
+
+    SHAN is free software: you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+	    the Free Software Foundation, either version 3 of the License, or
+	        (at your option) any later version.
+
+    SHAN is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+	    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	        GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+        along with SHAN.  If not, see <https://www.gnu.org/licenses/>.
+	
+*/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "SHAN_segment.h"
+#include "SHAN_comm.h"
+
+#include "shan_copy.h"
+#include "shan_util.h"
+#include "assert.h"
+
+
+#define GET_OFFSET(offset, i, sz) ((offset) != NULL ? (offset)[i] : (long) (i) * (sz))
+
+/* prefetch distance of streaming copies, contiguous (byte) and strided (elements) */
+#define SHAN_PREFETCH_DIST 512
+#define SHAN_PREFETCH_ELEM 8
+
+/* min contiguous run for streaming stores (byte), shorter runs use memcpy */
+#define SHAN_STREAM_MIN_RUN 1024
+
+
+long shan_copy_stream_default(int const nproc_local)
+{
+    long llc = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    if (llc <= 0)
+    {
+	llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    }
+#endif
+    if (llc <= 0)
+    {
+	return SHAN_STREAM_THRESHOLD;
+    }
+    return llc / MAX(nproc_local, 1);
+}
+
+
+/*
+ * contiguous copy with non-temporal stores, destination lines 
+ * bypass the cache. Requires shan_copy_stream_fence before the 
+ * data is published to other ranks or threads.
+ */
+static void shan_copy_stream(char *restrict dest
+			     , char const *restrict src
+			     , long sz
+    )
+{
+#ifdef __SSE2__
+    long i;
+    long const head = MIN((long) (-(uintptr_t) dest & 15), sz);
+    memcpy(dest, src, head);
+    dest += head;
+    src  += head;
+    sz   -= head;
+    for (i = 0; i + 64 <= sz; i += 64)
+    {
+	__builtin_prefetch(src + i + SHAN_PREFETCH_DIST, 0, 0);
+	__m128i const a = _mm_loadu_si128((__m128i const *) (src + i));
+	__m128i const b = _mm_loadu_si128((__m128i const *) (src + i + 16));
+	__m128i const c = _mm_loadu_si128((__m128i const *) (src + i + 32));
+	__m128i const d = _mm_loadu_si128((__m128i const *) (src + i + 48));
+	_mm_stream_si128((__m128i *) (dest + i), a);
+	_mm_stream_si128((__m128i *) (dest + i + 16), b);
+	_mm_stream_si128((__m128i *) (dest + i + 32), c);
+	_mm_stream_si128((__m128i *) (dest + i + 48), d);
+    }
+    memcpy(dest + i, src + i, sz - i);
+#else
+    memcpy(dest, src, sz);
+#endif
+}
+
+
+static inline void shan_copy_stream_fence(void)
+{
+#ifdef __SSE2__
+    _mm_sfence();
+#endif
+}
+
+
+/*
+ * strided copy, inlined with constant element size
+ * for the common cases in shan_copy_block.
+ * Optionally prefetches the source elements ahead.
+ */
+static inline void shan_copy_strided(char *restrict dest
+				     , long const dest_stride
+				     , char const *restrict src
+				     , long const src_stride
+				     , int const nelem
+				     , int const sz
+				     , int const prefetch
+    )
+{
+    int i;
+    if (prefetch)
+    {
+	for (i = 0; i < nelem; ++i)
+	{
+	    __builtin_prefetch(src + (i + SHAN_PREFETCH_ELEM) * src_stride, 0, 0);
+	    memcpy(dest + i * dest_stride, src + i * src_stride, sz);
+	}
+	return;
+    }
+    for (i = 0; i < nelem; ++i)
+    {
+	memcpy(dest + i * dest_stride, src + i * src_stride, sz);
+    }
+}
+
+
+static void shan_copy_block(char *restrict dest
+			    , long const dest_stride
+			    , char const *restrict src
+			    , long const src_stride
+			    , int const nelem
+			    , int const sz
+			    , int const stream
+    )
+{
+    if (dest_stride == sz && src_stride == sz)
+    {
+	long const run = (long) nelem * sz;
+	if (stream && run >= SHAN_STREAM_MIN_RUN)
+	{
+	    shan_copy_stream(dest, src, run);
+	}
+	else
+	{
+	    memcpy(dest, src, run);
+	}
+	return;
+    }
+
+    /*
+     * scattered destination lines are only partially written, 
+     * prefetch instead of streaming stores
+     */
+    switch (sz)
+    {
+    case 4:
+	shan_copy_strided(dest, dest_stride, src, src_stride, nelem, 4, stream);
+	break;
+    case 8:
+	shan_copy_strided(dest, dest_stride, src, src_stride, nelem, 8, stream);
+	break;
+    case 24:
+	shan_copy_strided(dest, dest_stride, src, src_stride, nelem, 24, stream);
+	break;
+    case 168:
+	/* NGRAD * 3 doubles, CFD-Proxy gradients */
+	shan_copy_strided(dest, dest_stride, src, src_stride, nelem, 168, stream);
+	break;
+    default:
+	shan_copy_strided(dest, dest_stride, src, src_stride, nelem, sz, stream);
+	break;
+    }
+}
+
+
+void shan_copy_desc_linear(shan_copy_desc_t *const desc)
+{
+    desc->offset = NULL;
+    desc->block  = NULL;
+    desc->nblock = 0;
+}
+
+
+void shan_copy_desc_send(shan_copy_desc_t *const desc
+			 , type_local_t const *const type_info
+			 , shan_element_t const *const type_element
+			 , int const idx
+    )
+{
+    shan_copy_desc_linear(desc);
+    if (type_element->offset_format == SHAN_OFFSET_BLOCK)
+    {
+	desc->block  = type_info->send_block + idx * type_info->max_nelem_send;
+	desc->nblock = type_info->nblock_send[idx];
+	ASSERT(desc->nblock <= type_info->max_nelem_send);
+    }
+    else
+    {
+	desc->offset = type_info->send_offset + idx * type_info->max_nelem_send;
+    }
+}
+
+
+void shan_copy_desc_recv(shan_copy_desc_t *const desc
+			 , type_local_t const *const type_info
+			 , shan_element_t const *const type_element
+			 , int const idx
+    )
+{
+    shan_copy_desc_linear(desc);
+    if (type_element->offset_format == SHAN_OFFSET_BLOCK)
+    {
+	desc->block  = type_info->recv_block + idx * type_info->max_nelem_recv;
+	desc->nblock = type_info->nblock_recv[idx];
+	ASSERT(desc->nblock <= type_info->max_nelem_recv);
+    }
+    else
+    {
+	desc->offset = type_info->recv_offset + idx * type_info->max_nelem_recv;
+    }
+}
+
+
+/*
+ * element offsets of a descriptor, offset blocks are expanded
+ * into tmp (to be freed by the caller).
+ */
+static long const *shan_copy_expand(shan_copy_desc_t const *const desc
+				    , int const nelem
+				    , long **tmp
+    )
+{
+    int i, j, k = 0;
+    *tmp = NULL;
+    if (desc->block == NULL || nelem == 0)
+    {
+	return desc->offset;
+    }
+
+    *tmp = check_malloc(nelem * sizeof(long));
+    for (i = 0; i < desc->nblock && k < nelem; ++i)
+    {
+	shan_offset_block_t const *const block = &(desc->block[i]);
+	for (j = 0; j < block->nelem && k < nelem; ++j)
+	{
+	    (*tmp)[k++] = block->base + j * block->stride;
+	}
+    }
+    ASSERT(k == nelem);
+
+    return *tmp;
+}
+
+
+void shan_copy_plan_init(shan_copy_plan_t *const plan)
+{
+    plan->nelem        = -1;
+    plan->elem_sz      = 0;
+    plan->nblock       = 0;
+    plan->src_version  = 0;
+    plan->dest_version = 0;
+    plan->block        = NULL;
+}
+
+
+void shan_copy_plan_free(shan_copy_plan_t *const plan)
+{
+    check_free(plan->block);
+    shan_copy_plan_init(plan);
+}
+
+
+/*
+ * length of the constant stride run starting at element i
+ */
+static int shan_copy_run(long const *src_offset
+			 , long const *dest_offset
+			 , int const i
+			 , int const nelem
+			 , int const sz
+			 , long *src_stride
+			 , long *dest_stride
+    )
+{
+    int n = 1;
+    *src_stride  = sz;
+    *dest_stride = sz;
+    if (i + 1 < nelem)
+    {
+	*src_stride  = GET_OFFSET(src_offset, i + 1, sz) - GET_OFFSET(src_offset, i, sz);
+	*dest_stride = GET_OFFSET(dest_offset, i + 1, sz) - GET_OFFSET(dest_offset, i, sz);
+	n = 2;
+	while (i + n < nelem
+	       && GET_OFFSET(src_offset, i + n, sz)
+	       - GET_OFFSET(src_offset, i + n - 1, sz) == *src_stride
+	       && GET_OFFSET(dest_offset, i + n, sz)
+	       - GET_OFFSET(dest_offset, i + n - 1, sz) == *dest_stride)
+	{
+	    n++;
+	}
+    }
+    return n;
+}
+
+
+void shan_copy_plan_compile(shan_copy_plan_t *const plan
+			    , shan_copy_desc_t const *const src_desc
+			    , shan_copy_desc_t const *const dest_desc
+			    , int const nelem
+			    , int const elem_sz
+    )
+{
+    int i, nblock = 0;
+    long src_stride, dest_stride;
+    ASSERT(nelem >= 0);
+    ASSERT(elem_sz >= 0);
+
+    shan_copy_plan_free(plan);
+
+    long *src_tmp, *dest_tmp;
+    long const *const src_offset  = shan_copy_expand(src_desc, nelem, &src_tmp);
+    long const *const dest_offset = shan_copy_expand(dest_desc, nelem, &dest_tmp);
+
+    /* count blocks */
+    for (i = 0; i < nelem; )
+    {
+	i += shan_copy_run(src_offset, dest_offset, i, nelem, elem_sz
+			   , &src_stride, &dest_stride);
+	nblock++;
+    }
+
+    if (nblock > 0)
+    {
+	plan->block = check_malloc(nblock * sizeof(shan_copy_block_t));
+    }
+
+    nblock = 0;
+    for (i = 0; i < nelem; )
+    {
+	int const n = shan_copy_run(src_offset, dest_offset, i, nelem, elem_sz
+				    , &src_stride, &dest_stride);
+	shan_copy_block_t *const block = &(plan->block[nblock++]);
+	block->src         = GET_OFFSET(src_offset, i, elem_sz);
+	block->dest        = GET_OFFSET(dest_offset, i, elem_sz);
+	block->src_stride  = src_stride;
+	block->dest_stride = dest_stride;
+	block->nelem       = n;
+	i += n;
+    }
+
+    plan->nblock  = nblock;
+    plan->nelem   = nelem;
+    plan->elem_sz = elem_sz;
+
+    check_free(src_tmp);
+    check_free(dest_tmp);
+}
+
+
+int shan_copy_plan_valid(shan_copy_plan_t const *const plan
+			 , int const nelem
+			 , int const elem_sz
+    )
+{
+    return plan->nelem == nelem && plan->elem_sz == elem_sz;
+}
+
+
+/*
+ * elements first .. last-1 of a compiled plan
+ */
+static void shan_copy_plan_range(shan_copy_plan_t const *const plan
+				 , void *const dest_ptr
+				 , void const *const src_ptr
+				 , int const first
+				 , int const last
+				 , int const stream
+    )
+{
+    int i, k = 0;
+    for (i = 0; i < plan->nblock && k < last; ++i)
+    {
+	shan_copy_block_t const *const block = &(plan->block[i]);
+	int const b0 = MAX(first - k, 0);
+	int const b1 = MIN(last - k, block->nelem);
+	k += block->nelem;
+	if (b0 >= b1)
+	{
+	    continue;
+	}
+	if (stream && i + 1 < plan->nblock)
+	{
+	    __builtin_prefetch((char const *) src_ptr + plan->block[i + 1].src, 0, 0);
+	}
+	shan_copy_block((char *) dest_ptr + block->dest + b0 * block->dest_stride
+			, block->dest_stride
+			, (char const *) src_ptr + block->src + b0 * block->src_stride
+			, block->src_stride
+			, b1 - b0
+			, plan->elem_sz
+			, stream
+	    );
+    }
+    if (stream)
+    {
+	shan_copy_stream_fence();
+    }
+}
+
+
+/*
+ * elements first .. last-1 of offset lists or linear buffers
+ */
+static void shan_copy_elements_range(void *const dest_ptr
+				     , shan_copy_desc_t const *const dest_desc
+				     , void const *const src_ptr
+				     , shan_copy_desc_t const *const src_desc
+				     , int const first
+				     , int const last
+				     , int const elem_sz
+				     , int const prefetch
+    )
+{
+    int i;
+    long const *const dest_offset = dest_desc->offset;
+    long const *const src_offset  = src_desc->offset;
+    for (i = first; i < last; ++i)
+    {
+	if (prefetch && i + SHAN_PREFETCH_ELEM < last)
+	{
+	    __builtin_prefetch((char const *) src_ptr 
+			       + GET_OFFSET(src_offset, i + SHAN_PREFETCH_ELEM, elem_sz), 0, 0);
+	}
+	void *restrict dest = (char *) dest_ptr + GET_OFFSET(dest_offset, i, elem_sz);
+	void const *restrict src = (char const *) src_ptr + GET_OFFSET(src_offset, i, elem_sz);
+	memcpy(dest, src, elem_sz);
+    }
+}
+
+
+/*
+ * position in an offset descriptor, walked run by run 
+ * (uncompiled block descriptors)
+ */
+typedef struct
+{
+    shan_copy_desc_t const *desc;
+    int elem;                    //!< element index
+    int blk;                     //!< current offset block
+    int pos;                     //!< element in current offset block
+} shan_copy_cursor_t;
+
+
+static void shan_copy_cursor_advance(shan_copy_cursor_t *const cursor
+				     , int const n
+    )
+{
+    shan_copy_desc_t const *const desc = cursor->desc;
+    cursor->elem += n;
+    if (desc->block != NULL)
+    {
+	cursor->pos += n;
+	while (cursor->blk < desc->nblock 
+	       && cursor->pos >= desc->block[cursor->blk].nelem)
+	{
+	    cursor->pos -= desc->block[cursor->blk].nelem;
+	    cursor->blk++;
+	}
+    }
+}
+
+
+static void shan_copy_cursor_init(shan_copy_cursor_t *const cursor
+				  , shan_copy_desc_t const *const desc
+				  , int const first
+    )
+{
+    cursor->desc = desc;
+    cursor->elem = 0;
+    cursor->blk  = 0;
+    cursor->pos  = 0;
+    shan_copy_cursor_advance(cursor, first);
+}
+
+
+/*
+ * constant stride run (at most max elements) at the cursor
+ */
+static int shan_copy_cursor_run(shan_copy_cursor_t const *const cursor
+				, int const elem_sz
+				, int const max
+				, long *offset
+				, long *stride
+    )
+{
+    shan_copy_desc_t const *const desc = cursor->desc;
+    if (desc->block != NULL)
+    {
+	ASSERT(cursor->blk < desc->nblock);
+	shan_offset_block_t const *const block = &(desc->block[cursor->blk]);
+	*offset = block->base + cursor->pos * block->stride;
+	*stride = block->stride;
+	return MIN(max, block->nelem - cursor->pos);
+    }
+    *offset = GET_OFFSET(desc->offset, cursor->elem, elem_sz);
+    *stride = elem_sz;
+    return (desc->offset != NULL) ? 1 : max;
+}
+
+
+/*
+ * elements first .. last-1 of block descriptors, 
+ * run by run without a compiled plan
+ */
+static void shan_copy_blocks_range(void *const dest_ptr
+				   , shan_copy_desc_t const *const dest_desc
+				   , void const *const src_ptr
+				   , shan_copy_desc_t const *const src_desc
+				   , int const first
+				   , int const last
+				   , int const elem_sz
+				   , int const stream
+    )
+{
+    int i;
+    shan_copy_cursor_t src, dest;
+    shan_copy_cursor_init(&src, src_desc, first);
+    shan_copy_cursor_init(&dest, dest_desc, first);
+    for (i = first; i < last; )
+    {
+	long src_offset, src_stride, dest_offset, dest_stride;
+	int n = shan_copy_cursor_run(&src, elem_sz, last - i, &src_offset, &src_stride);
+	n = shan_copy_cursor_run(&dest, elem_sz, n, &dest_offset, &dest_stride);
+	shan_copy_block((char *) dest_ptr + dest_offset
+			, dest_stride
+			, (char const *) src_ptr + src_offset
+			, src_stride
+			, n
+			, elem_sz
+			, stream
+	    );
+	shan_copy_cursor_advance(&src, n);
+	shan_copy_cursor_advance(&dest, n);
+	i += n;
+    }
+    if (stream)
+    {
+	shan_copy_stream_fence();
+    }
+}
+
+
+void shan_copy_plan_execute(shan_copy_plan_t const *const plan
+			    , void *const dest_ptr
+			    , void const *const src_ptr
+			    , long const stream_threshold
+    )
+{
+    int const stream = stream_threshold >= 0
+	&& (long) plan->nelem * plan->elem_sz >= stream_threshold;
+    shan_copy_plan_range(plan
+			 , dest_ptr
+			 , src_ptr
+			 , 0
+			 , plan->nelem
+			 , stream
+	);
+}
+
+
+void shan_copy_elements(void *const dest_ptr
+			, shan_copy_desc_t const *const dest_desc
+			, void const *const src_ptr
+			, shan_copy_desc_t const *const src_desc
+			, int const nelem
+			, int const elem_sz
+			, long const stream_threshold
+    )
+{
+    int const stream = stream_threshold >= 0
+	&& (long) nelem * elem_sz >= stream_threshold;
+    if (dest_desc->block != NULL || src_desc->block != NULL)
+    {
+	shan_copy_blocks_range(dest_ptr
+			       , dest_desc
+			       , src_ptr
+			       , src_desc
+			       , 0
+			       , nelem
+			       , elem_sz
+			       , stream
+	    );
+	return;
+    }
+
+    shan_copy_elements_range(dest_ptr
+			     , dest_desc
+			     , src_ptr
+			     , src_desc
+			     , 0
+			     , nelem
+			     , elem_sz
+			     , stream
+	);
+}
+
+
+/*
+ * one chunk of a team copy
+ */
+typedef struct
+{
+    shan_copy_plan_t const *plan;
+    void *dest_ptr;
+    shan_copy_desc_t const *dest_desc;
+    void const *src_ptr;
+    shan_copy_desc_t const *src_desc;
+    int nelem;
+    int elem_sz;
+    int stream;
+    int num_chunk;
+} shan_copy_task_t;
+
+
+static void shan_copy_chunk(void *arg
+			    , int ichunk
+    )
+{
+    shan_copy_task_t const *const task = (shan_copy_task_t const *) arg;
+    int const first = (int) ((long) task->nelem * ichunk / task->num_chunk);
+    int const last  = (int) ((long) task->nelem * (ichunk + 1) / task->num_chunk);
+    if (task->plan != NULL)
+    {
+	shan_copy_plan_range(task->plan
+			     , task->dest_ptr
+			     , task->src_ptr
+			     , first
+			     , last
+			     , task->stream
+	    );
+    }
+    else if (task->dest_desc->block != NULL || task->src_desc->block != NULL)
+    {
+	shan_copy_blocks_range(task->dest_ptr
+			       , task->dest_desc
+			       , task->src_ptr
+			       , task->src_desc
+			       , first
+			       , last
+			       , task->elem_sz
+			       , task->stream
+	    );
+    }
+    else
+    {
+	shan_copy_elements_range(task->dest_ptr
+				 , task->dest_desc
+				 , task->src_ptr
+				 , task->src_desc
+				 , first
+				 , last
+				 , task->elem_sz
+				 , task->stream
+	    );
+    }
+}
+
+
+void shan_copy_team(shan_unpack_team_t const *const team
+		    , shan_copy_plan_t const *const plan
+		    , void *const dest_ptr
+		    , shan_copy_desc_t const *const dest_desc
+		    , void const *const src_ptr
+		    , shan_copy_desc_t const *const src_desc
+		    , int const nelem
+		    , int const elem_sz
+		    , long const stream_threshold
+    )
+{
+    int i;
+    long const sz = (long) nelem * elem_sz;
+    if (team->num_thread < 2 || sz < team->cutoff || nelem < 2)
+    {
+	if (plan != NULL)
+	{
+	    shan_copy_plan_execute(plan, dest_ptr, src_ptr, stream_threshold);
+	}
+	else
+	{
+	    shan_copy_elements(dest_ptr
+			       , dest_desc
+			       , src_ptr
+			       , src_desc
+			       , nelem
+			       , elem_sz
+			       , stream_threshold
+		);
+	}
+	return;
+    }
+
+    shan_copy_task_t task;
+    task.plan      = plan;
+    task.dest_ptr  = dest_ptr;
+    task.dest_desc = dest_desc;
+    task.src_ptr   = src_ptr;
+    task.src_desc  = src_desc;
+    task.nelem     = nelem;
+    task.elem_sz   = elem_sz;
+    task.stream    = stream_threshold >= 0 && sz >= stream_threshold;
+    task.num_chunk = MIN(team->num_thread, nelem);
+
+    if (team->parallel_for != NULL)
+    {
+	team->parallel_for(task.num_chunk
+			   , shan_copy_chunk
+			   , &task
+			   , team->user_data
+	    );
+	return;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(task.num_chunk) schedule(static, 1)
+#endif
+    for (i = 0; i < task.num_chunk; ++i)
+    {
+	shan_copy_chunk(&task, i);
+    }
+}
@@ -0,0 +1,195 @@
+/*
+    Copyright (c) T-Systems SfR, C.Simmendinger <christian.simmendinger@t-systems.com>, 2018
+
+    This file is part of SHAN.
+
+    SHAN is free software: you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+	    the Free Software Foundation, either version 3 of the License, or
+	        (at your option) any later version.
+
+    SHAN is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+	    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	        GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+        along with SHAN.  If not, see <https://www.gnu.org/licenses/>.
+	
+*/
+
+
+
+#ifndef SHAN_COPY_H
+#define SHAN_COPY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SHAN_comm.h"
+
+
+/* default stream threshold (byte) if the cache size is unknown */
+#define SHAN_STREAM_THRESHOLD (1L << 20)
+
+
+/** Element offset descriptor of one side of a copy.
+ *  Either an offset list, a list of offset blocks or, 
+ *  if both are NULL, a linear buffer.
+ */
+typedef struct
+{
+    long const *offset;                //!< element offsets (byte)
+    shan_offset_block_t const *block;  //!< offset blocks
+    int nblock;                        //!< number of offset blocks
+} shan_copy_desc_t;
+
+
+/** Default copy size from which non-temporal stores are used,
+ *  the last level cache share of a node local rank.
+ *
+ * @param nproc_local - number of node local ranks
+ *
+ * @return stream threshold (byte)
+ */
+long shan_copy_stream_default(int const nproc_local);
+
+/** Descriptor for a linear (packed) buffer.
+ *
+ * @param desc - offset descriptor
+ */
+void shan_copy_desc_linear(shan_copy_desc_t *const desc);
+
+/** Descriptor for the send elements of a type.
+ *
+ * @param desc         - offset descriptor
+ * @param type_info    - type data struct (SHAN_comm.h)
+ * @param type_element - type element
+ * @param idx          - comm index in type_info
+ */
+void shan_copy_desc_send(shan_copy_desc_t *const desc
+			 , type_local_t const *const type_info
+			 , shan_element_t const *const type_element
+			 , int const idx
+    );
+
+/** Descriptor for the recv elements of a type.
+ *
+ * @param desc         - offset descriptor
+ * @param type_info    - type data struct (SHAN_comm.h)
+ * @param type_element - type element
+ * @param idx          - comm index in type_info
+ */
+void shan_copy_desc_recv(shan_copy_desc_t *const desc
+			 , type_local_t const *const type_info
+			 , shan_element_t const *const type_element
+			 , int const idx
+    );
+
+
+/** Resets a copy plan to the 'not compiled' state.
+ *
+ * @param plan - copy plan
+ */
+void shan_copy_plan_init(shan_copy_plan_t *const plan);
+
+/** Frees the block list of a copy plan.
+ *
+ * @param plan - copy plan
+ */
+void shan_copy_plan_free(shan_copy_plan_t *const plan);
+
+/** Compiles element offsets into a list of copy blocks.
+ *  Consecutive elements with constant source and destination
+ *  strides are coalesced into a single block, contiguous
+ *  runs into a single memcpy.
+ *
+ * @param plan      - copy plan
+ * @param src_desc  - source offset descriptor
+ * @param dest_desc - destination offset descriptor
+ * @param nelem     - number of elements
+ * @param elem_sz   - element size (byte)
+ */
+void shan_copy_plan_compile(shan_copy_plan_t *const plan
+			    , shan_copy_desc_t const *const src_desc
+			    , shan_copy_desc_t const *const dest_desc
+			    , int const nelem
+			    , int const elem_sz
+    );
+
+/** Tests whether a plan was compiled for nelem elements of size elem_sz.
+ *
+ * @param plan    - copy plan
+ * @param nelem   - current number of elements
+ * @param elem_sz - current element size (byte)
+ *
+ * @return 1 if plan can be executed, 0 otherwise.
+ */
+int shan_copy_plan_valid(shan_copy_plan_t const *const plan
+			 , int const nelem
+			 , int const elem_sz
+    );
+
+/** Executes a compiled copy plan.
+ *  Plans of at least stream_threshold bytes prefetch the next 
+ *  source block and write long contiguous runs with non-temporal
+ *  stores (fenced before returning).
+ *
+ * @param plan             - copy plan
+ * @param dest_ptr         - destination base pointer
+ * @param src_ptr          - source base pointer
+ * @param stream_threshold - min copy size for streaming (byte), -1 for never
+ */
+void shan_copy_plan_execute(shan_copy_plan_t const *const plan
+			    , void *const dest_ptr
+			    , void const *const src_ptr
+			    , long const stream_threshold
+    );
+
+/** Element-wise copy for uncompiled types.
+ *  Offset blocks are walked run by run, i.e. no plan 
+ *  is compiled (and allocated) per copy.
+ *
+ * @param dest_ptr  - destination base pointer
+ * @param dest_desc - destination offset descriptor
+ * @param src_ptr   - source base pointer
+ * @param src_desc  - source offset descriptor
+ * @param nelem     - number of elements
+ * @param elem_sz   - element size (byte)
+ * @param stream_threshold - min copy size for streaming (byte), -1 for never
+ */
+void shan_copy_elements(void *const dest_ptr
+			, shan_copy_desc_t const *const dest_desc
+			, void const *const src_ptr
+			, shan_copy_desc_t const *const src_desc
+			, int const nelem
+			, int const elem_sz
+			, long const stream_threshold
+    );
+
+/** Copy of a receive, split into chunks for a thread team
+ *  (shan_comm_set_unpack_team). Falls back to a single thread 
+ *  below the cutoff of the team.
+ *
+ * @param team      - thread team
+ * @param plan      - compiled copy plan, NULL to copy by descriptors
+ * @param dest_ptr  - destination base pointer
+ * @param dest_desc - destination offset descriptor
+ * @param src_ptr   - source base pointer
+ * @param src_desc  - source offset descriptor
+ * @param nelem     - number of elements
+ * @param elem_sz   - element size (byte)
+ * @param stream_threshold - min copy size for streaming (byte), -1 for never
+ */
+void shan_copy_team(shan_unpack_team_t const *const team
+		    , shan_copy_plan_t const *const plan
+		    , void *const dest_ptr
+		    , shan_copy_desc_t const *const dest_desc
+		    , void const *const src_ptr
+		    , shan_copy_desc_t const *const src_desc
+		    , int const nelem
+		    , int const elem_sz
+		    , long const stream_threshold
+    );
+
+#endif
@@ -29,6 +29,7 @@
 #include <limits.h>
 #include <string.h>
 #include <xmmintrin.h>
+#include <sched.h>
 
 #include <GASPI.h>
 
@@ -37,38 +38,25 @@
 #include "SHAN_type.h"
 
 #include "shan_core.h"
-#include "shan_exchange.h"
 #include "gaspi_util.h"
 #include "shan_util.h"
+#include "shan_copy.h"
 #include "assert.h"
 
 
-#define GET_NOTIFICATION_ID(sid, num_type, type_id, num_neighbors, idx) \
-  ((sid) * ((num_type) * (num_neighbors)) + (type_id) * (num_neighbors) + (idx))  
-
-#ifndef USE_NOCOS
-#define GASPI_PROC_LOCAL 0
-#endif
-
 void shan_test_shared(shan_neighborhood_t *const neighborhood_id
-		      , int const rank_local
-		      , int const num_neighbors
 		      , int const type_id
 		      , int const idx
+		      , int const nid
 		      , int *rval
     )
 {
-    shan_segment_t *const shared_segment = &(neighborhood_id->shared_segment);
-    long const typeOffset 
-	= num_neighbors * neighborhood_id->type_element[type_id].elemOffset;
-  
-    void *shm_ptr = NULL; 
-    shan_get_shared_ptr(shared_segment
-			, rank_local
-			, &shm_ptr
-	);  
-    shan_notify_test_shared((shan_notification_t *) ((char*) shm_ptr + typeOffset)
-			    , idx
+    shan_handle_t const *const handle 
+	= &(neighborhood_id->type_element[type_id].handle[idx]);
+    ASSERT(handle->local_rank != -1);
+
+    shan_notify_test_shared(handle->remote_type.nid
+			    , nid
 			    , rval
 	);
 }
@@ -78,23 +66,311 @@ int shan_increment_local(shan_neighborhood_t *const neighborhood_id
 			 , int const idx
 			 ) 
 {
-    shan_segment_t *const shared_segment = &(neighborhood_id->shared_segment);
-    long const typeOffset 
-	= neighborhood_id->num_neighbors * neighborhood_id->type_element[type_id].elemOffset;
-  
-    void *shm_ptr = NULL; 
-    shan_get_shared_ptr(shared_segment
-			, neighborhood_id->iProcLocal
-			, &shm_ptr
-	);
-    shan_notify_increment_shared((shan_notification_t *)((char*) shm_ptr + typeOffset)
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    shan_notify_increment_shared(neighborhood_id->type_element[type_id].local_type.nid
 				 , idx
 				 , 1
 	);        
+
+    /*
+     * 'have written' (idx < num_neighbors) or 'have read', 
+     * set own bit in the mailbox of the neighbor, 
+     * after the notification above has become visible.
+     */
+    int const dir = (idx < num_neighbors) ? SHAN_MAILBOX_RECV : SHAN_MAILBOX_ACK;
+    int const nidx = (idx < num_neighbors) ? idx : idx - num_neighbors;
+    shan_handle_t const *const handle 
+	= &(neighborhood_id->type_element[type_id].handle[nidx]);
+    int const bit = neighborhood_id->RemoteCommIndex[nidx];
+    uint64_t *const word 
+	= handle->remote_mailbox + dir * handle->remote_mailbox_nword + bit / 64;
+    __atomic_fetch_or(word, (uint64_t) 1 << (bit % 64), __ATOMIC_RELEASE);
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_mailbox_test(shan_neighborhood_t *const neighborhood_id
+		      , int const type_id
+		      , int const idx
+		      , int const dir
+    )
+{
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    int const nword = MAILBOX_NWORD(neighborhood_id->num_neighbors);
+    int const w = dir * nword + idx / 64;
+    uint64_t const mask = (uint64_t) 1 << (idx % 64);
+
+    /*
+     * the exchange takes the bits of all neighbors in the word,
+     * other threads may drive those, i.e. pending bits are 
+     * only updated atomically
+     */
+    if (!(__atomic_load_n(&(type_element->mailbox_pending[w]), __ATOMIC_ACQUIRE) & mask)
+	&& __atomic_load_n(&(type_element->mailbox[w]), __ATOMIC_ACQUIRE) != 0)
+    {
+	uint64_t const bits 
+	    = __atomic_exchange_n(&(type_element->mailbox[w]), 0, __ATOMIC_ACQ_REL);
+	__atomic_fetch_or(&(type_element->mailbox_pending[w]), bits, __ATOMIC_ACQ_REL);
+    }
+
+    return (__atomic_load_n(&(type_element->mailbox_pending[w]), __ATOMIC_ACQUIRE) & mask) != 0;
+}
+
+
+void shan_mailbox_clear(shan_neighborhood_t *const neighborhood_id
+			, int const type_id
+			, int const idx
+			, int const dir
+    )
+{
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    int const nword = MAILBOX_NWORD(neighborhood_id->num_neighbors);
+
+    __atomic_fetch_and(&(type_element->mailbox_pending[dir * nword + idx / 64])
+		       , ~((uint64_t) 1 << (idx % 64))
+		       , __ATOMIC_ACQ_REL);
+}
+
+
+void shan_mailbox_fetch(shan_neighborhood_t *const neighborhood_id
+			, int const type_id
+			, int const dir
+    )
+{
+    int i;
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    int const nword = MAILBOX_NWORD(neighborhood_id->num_neighbors);
+
+    for (i = dir * nword; i < (dir + 1) * nword; ++i)
+    {
+	if (__atomic_load_n(&(type_element->mailbox[i]), __ATOMIC_ACQUIRE) != 0)
+	{
+	    uint64_t const bits 
+		= __atomic_exchange_n(&(type_element->mailbox[i]), 0, __ATOMIC_ACQ_REL);
+	    __atomic_fetch_or(&(type_element->mailbox_pending[i]), bits, __ATOMIC_ACQ_REL);
+	}
+    }
+}
+
+
+int shan_comm_set_wait_policy(shan_neighborhood_t *const neighborhood_id
+			      , int wait_policy
+			      , int spin_count
+    )
+{
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(wait_policy == SHAN_WAIT_SPIN 
+	   || wait_policy == SHAN_WAIT_YIELD
+	   || wait_policy == SHAN_WAIT_BLOCK);
+    ASSERT(spin_count >= 0);
+
+    neighborhood_id->wait_policy = wait_policy;
+    neighborhood_id->wait_spin   = spin_count;
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_set_coalescing(shan_neighborhood_t *const neighborhood_id
+			     , int enable
+    )
+{
+    int i;
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(enable == 0 || enable == 1);
+
+    neighborhood_id->coalesce = enable;
+
+    /*
+     * has to match per comm pair, neighbors only
+     */
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int *remote_coalesce = check_malloc(MAX(num_neighbors, 1) * sizeof(int));
+    MPI_Neighbor_allgather(&enable
+			   , 1
+			   , MPI_INT
+			   , remote_coalesce
+			   , 1
+			   , MPI_INT
+			   , neighborhood_id->MPI_COMM_GRAPH
+	);
+    for (i = 0; i < num_neighbors; ++i)
+    {
+	ASSERT(remote_coalesce[i] == enable);
+    }
+    check_free(remote_coalesce);
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_set_push(shan_neighborhood_t *const neighborhood_id
+		       , int type_id
+		       , int enable
+    )
+{
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(type_id >= 0 && type_id < neighborhood_id->num_type);
+    ASSERT(enable == 0 || enable == 1);
+
+    neighborhood_id->type_element[type_id].push = enable;
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_set_pull(shan_neighborhood_t *const neighborhood_id
+		       , int type_id
+		       , int enable
+    )
+{
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(type_id >= 0 && type_id < neighborhood_id->num_type);
+    ASSERT(enable == 0 || enable == 1);
+
+    neighborhood_id->type_element[type_id].pull = enable;
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_get_stats(shan_neighborhood_t *const neighborhood_id
+			, int type_id
+			, int idx
+			, shan_stats_t *stats
+    )
+{
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(type_id >= 0 && type_id < neighborhood_id->num_type);
+    ASSERT(idx >= 0 && idx < neighborhood_id->num_neighbors);
+    ASSERT(stats != NULL);
+
+    *stats = neighborhood_id->type_element[type_id].stats[idx];
+    stats->local = (neighborhood_id->local_rank[idx] != -1);
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_set_stats_dump(shan_neighborhood_t *const neighborhood_id
+			     , int enable
+    )
+{
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(enable == 0 || enable == 1);
+
+    neighborhood_id->stats_dump = enable;
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_set_unpack_team(shan_neighborhood_t *const neighborhood_id
+			      , int num_thread
+			      , long cutoff
+			      , shan_parallel_for_t parallel_for
+			      , void *user_data
+    )
+{
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(num_thread >= 1);
+    ASSERT(cutoff >= 0);
+
+    neighborhood_id->unpack_team.num_thread   = num_thread;
+    neighborhood_id->unpack_team.cutoff       = cutoff;
+    neighborhood_id->unpack_team.parallel_for = parallel_for;
+    neighborhood_id->unpack_team.user_data    = user_data;
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_set_stream_threshold(shan_neighborhood_t *const neighborhood_id
+				   , int type_id
+				   , long threshold
+    )
+{
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(type_id >= 0 && type_id < neighborhood_id->num_type);
+    ASSERT(threshold >= -1);
+
+    neighborhood_id->type_element[type_id].stream_threshold = (threshold == 0) 
+	? shan_copy_stream_default(neighborhood_id->nProcLocal) : threshold;
+
     return SHAN_SUCCESS;
 }
 
 
+void shan_comm_backoff(shan_neighborhood_t *const neighborhood_id
+		       , int const type_id
+		       , int const idx
+		       , int const send
+		       , int *const iter
+    )
+{
+    if (neighborhood_id->wait_policy == SHAN_WAIT_SPIN
+	|| (*iter)++ < neighborhood_id->wait_spin)
+    {
+	_mm_pause();
+	return;
+    }
+
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    if (neighborhood_id->wait_policy == SHAN_WAIT_YIELD
+	|| idx == -1
+	|| type_element->handle[idx].local_rank == -1)
+    {
+	sched_yield();
+	return;
+    }
+
+    /*
+     * block on the notification of the local comm partner, 
+     * i.e. the one tested in waitsome_local or test4Send
+     */
+    int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
+    int const RemoteNumNeighbors = neighborhood_id->RemoteNumNeighbors[idx];
+    int const nid = send ? RemoteNumNeighbors + RemoteCommIdx : RemoteCommIdx;
+    int const val = send ? type_element->local_ack_count[idx] 
+	: type_element->local_recv_count[idx];
+
+    shan_notify_wait_shared(type_element->handle[idx].remote_type.nid
+			    , nid
+			    , val
+			    , SHAN_WAIT_TIMEOUT_US
+	);
+}
+
+
+void shan_comm_backoff_shared(shan_neighborhood_t *const neighborhood_id
+			      , shan_notification_t *const ptr
+			      , int const nid
+			      , int const val
+			      , int *const iter
+    )
+{
+    if (neighborhood_id->wait_policy == SHAN_WAIT_SPIN
+	|| (*iter)++ < neighborhood_id->wait_spin)
+    {
+	_mm_pause();
+	return;
+    }
+
+    if (neighborhood_id->wait_policy == SHAN_WAIT_YIELD)
+    {
+	sched_yield();
+	return;
+    }
+
+    shan_notify_wait_shared(ptr
+			    , nid
+			    , val
+			    , SHAN_WAIT_TIMEOUT_US
+	);
+}
+
+
 static int shan_alloc_remote(shan_remote_t * const segment   
 			     , int const shan_id
 			     , const long dataSz
@@ -130,6 +406,156 @@ static int shan_free_remote(shan_remote_t * const segment)
 }
 
 
+/* connection setup state per neighbor */
+enum 
+{
+    SHAN_SETUP_DONE = 0,
+    SHAN_SETUP_CONNECT,
+    SHAN_SETUP_REGISTER
+};
+
+/*
+ * connect to remote neighbors and register the remote comm segment.
+ * connected: per neighbor, 1 if already connected and registered, 
+ * NULL for none. Registration is repeated for a rebound segment.
+ * 
+ * All neighbors are progressed round robin with GASPI_TEST, i.e. 
+ * connections and registrations of different neighbors overlap 
+ * instead of one blocking setup after another.
+ */
+static void shan_comm_register_remote(shan_neighborhood_t *const neighborhood_id
+				      , const gaspi_segment_id_t segment_id
+				      , int const *const connected
+				      , int const rebound
+    )
+{
+    int i;    
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int *state = check_malloc(num_neighbors * sizeof(int));
+    int num_pending = 0;
+    for (i = 0; i < num_neighbors; ++i)
+    {
+	state[i] = SHAN_SETUP_DONE;
+	if (neighborhood_id->local_rank[i] != -1)
+	{
+	    continue;
+	}
+	if (connected == NULL || !connected[i])
+	{    
+	    state[i] = SHAN_SETUP_CONNECT;
+	    num_pending++;
+	}
+	else if (rebound)
+	{
+	    state[i] = SHAN_SETUP_REGISTER;
+	    num_pending++;
+	}
+    }
+
+    while (num_pending > 0)
+    {
+	for (i = 0; i < num_neighbors; ++i)
+	{
+	    int const rank = neighborhood_id->neighbors[i];
+	    gaspi_return_t ret;
+	    if (state[i] == SHAN_SETUP_CONNECT)
+	    {
+		/* 
+		 * connect to comm partner
+		 */
+		if ((ret = gaspi_connect (rank, GASPI_TEST)) == GASPI_SUCCESS)
+		{
+		    state[i] = SHAN_SETUP_REGISTER;
+		}
+		else
+		{
+		    ASSERT(ret == GASPI_TIMEOUT);
+		}
+	    }
+	    if (state[i] == SHAN_SETUP_REGISTER)
+	    {
+		/* 
+		 * register segment with comm partner
+		 */
+		if ((ret = gaspi_segment_register(segment_id
+						  , rank
+						  , GASPI_TEST
+			 )) == GASPI_SUCCESS)
+		{
+		    state[i] = SHAN_SETUP_DONE;
+		    num_pending--;
+		}
+		else
+		{
+		    ASSERT(ret == GASPI_TIMEOUT);
+		}
+	    }
+	}
+    }
+    check_free(state);
+}
+
+
+/*
+ * make the data segment for direct receives remotely accessible 
+ * for all remote neighbors it is not registered with yet
+ */
+static void shan_comm_register_direct(shan_neighborhood_t *const neighborhood_id)
+{
+    int i;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const gaspi_id = neighborhood_id->direct_gaspi_id;
+    if (gaspi_id < 0)
+    {
+	return;
+    }
+
+    int *registered = check_malloc(num_neighbors * sizeof(int));
+    for (i = 0; i < num_neighbors; ++i)
+    {
+	registered[i] = (neighborhood_id->direct_segment[i] == gaspi_id);
+    }
+    shan_comm_register_remote(neighborhood_id
+			      , (gaspi_segment_id_t) gaspi_id
+			      , registered
+			      , 0
+	);
+    for (i = 0; i < num_neighbors; ++i)
+    {
+	if (neighborhood_id->local_rank[i] == -1)
+	{
+	    neighborhood_id->direct_segment[i] = gaspi_id;
+	}
+    }
+    check_free(registered);
+}
+
+
+int shan_comm_set_direct(shan_neighborhood_t *const neighborhood_id
+			 , int type_id
+			 , shan_segment_t *const data_segment
+			 , int enable
+    )
+{
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(type_id >= 0 && type_id < neighborhood_id->num_type);
+    ASSERT(enable == 0 || enable == 1);
+
+    if (enable)
+    {
+	ASSERT(data_segment != NULL);
+	ASSERT(data_segment->gaspi_id >= 0);
+	ASSERT(neighborhood_id->direct_gaspi_id == -1
+	       || neighborhood_id->direct_gaspi_id == data_segment->gaspi_id);
+	neighborhood_id->direct_gaspi_id = data_segment->gaspi_id;
+	shan_comm_register_direct(neighborhood_id);
+    }
+    neighborhood_id->type_element[type_id].direct = enable;
+
+    return SHAN_SUCCESS;
+}
+
+
 static void bind_to_segment(shan_neighborhood_t *const neighborhood_id
 			    , const gaspi_segment_id_t segment_id
 			    )
@@ -157,34 +583,49 @@ static void bind_to_segment(shan_neighborhood_t *const neighborhood_id
 			    ));
     }
 
-    MPI_Barrier(neighborhood_id->MPI_COMM_ALL);
-
+    /* 
+     * readiness of neighbors is synchronized at the end of 
+     * shan_comm_init_comm, neighbors only
+     */
     if (CommSz > 0)
     {
-	int i;    
-	for (i = 0; i < neighborhood_id->num_neighbors; ++i)
-	{
-	    int const rank = neighborhood_id->neighbors[i];
-	    if(shan_comm_local_rank(neighborhood_id
-				    , rank
-		   ) == -1)
-	    {    
-		/* 
-		 * connect to comm partner and register
-		 */
-		SUCCESS_OR_DIE( gaspi_connect (rank, GASPI_BLOCK));
-		SUCCESS_OR_DIE( gaspi_segment_register((gaspi_segment_id_t) segment_id
-						       , rank
-						       , GASPI_BLOCK
-				    ));
-	    }
-	}
+	shan_comm_register_remote(neighborhood_id
+				  , segment_id
+				  , NULL
+				  , 1
+	    );
     }
+}
 
-    MPI_Barrier(neighborhood_id->MPI_COMM_ALL);
+/*
+ * reset notifications of the remote comm segment, at least the first 
+ * num_reset (e.g. used by a previous neighborhood)
+ */
+static void shan_comm_reset_notifications(shan_neighborhood_t *const neighborhood_id
+					  , int const num_reset
+    )
+{
+    int i;
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+    gaspi_number_t notification_num;
+    SUCCESS_OR_DIE(gaspi_notification_num (&notification_num));
+    int max_notifications = NUM_NOTIFICATION(neighborhood_id->num_buffer_max
+					     , neighborhood_id->num_type
+					     , neighborhood_id->num_neighbors);
 
+    ASSERT(max_notifications < (int) notification_num);
+    max_notifications = MIN(MAX(max_notifications, num_reset), (int) notification_num);
+    for (i = 0; i < max_notifications ; ++i)
+    {
+	gaspi_notification_t nval;
+	SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
+					   , (gaspi_notification_id_t) i
+					   , &nval
+			   ));
+    }
 }
 
+
 static void shan_comm_alloc_comm(shan_neighborhood_t *const neighborhood_id)
 {
     int i;
@@ -242,183 +683,553 @@ static void shan_comm_alloc_comm(shan_neighborhood_t *const neighborhood_id)
 	    );
     }
 
-    gaspi_number_t notification_num;
-    SUCCESS_OR_DIE(gaspi_notification_num (&notification_num));
-    int max_notifications = 2 * neighborhood_id->num_neighbors
-	* neighborhood_id->num_type;
+    shan_comm_reset_notifications(neighborhood_id
+				  , 0
+	);
+}
 
-    ASSERT(max_notifications < (int) notification_num);
-    for (i = 0; i < max_notifications ; ++i)
+/*
+ * process wide thread index, assigned on first use
+ */
+static volatile int shan_num_thread = 0;
+static __thread int shan_thread_id = -1;
+
+static int shan_thread_index(void)
+{
+    if (shan_thread_id == -1)
     {
-	gaspi_notification_t nval;
-	SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
-					   , (gaspi_notification_id_t) i
-					   , &nval
-			   ));
+	shan_thread_id = __sync_fetch_and_add(&shan_num_thread, 1);
+    }
+    return shan_thread_id;
+}
+
+
+gaspi_queue_id_t shan_comm_queue(shan_neighborhood_t const *const neighborhood_id
+				 , int const type_id
+				 , int const idx
+    )
+{
+    int key = idx;
+    if (neighborhood_id->queue_affinity == SHAN_QUEUE_TYPE)
+    {
+	key = type_id;
+    }
+    else if (neighborhood_id->queue_affinity == SHAN_QUEUE_THREAD)
+    {
+	key = shan_thread_index();
+    }
+    return (gaspi_queue_id_t) (key % neighborhood_id->num_queue);
+}
+
+
+static int shan_comm_queue_room(shan_neighborhood_t const *const neighborhood_id
+				, gaspi_queue_id_t const queue
+				, int const num_req
+    )
+{
+    gaspi_number_t queue_size;
+    SUCCESS_OR_DIE (gaspi_queue_size (queue, &queue_size));
+    if ((int) queue_size + num_req <= neighborhood_id->queue_size_max)
+    {
+	return 1;
+    }
+
+    /*
+     * drain completed requests, do not block 
+     */
+    gaspi_return_t ret;
+    if ((ret = gaspi_wait (queue, GASPI_TEST)) != GASPI_SUCCESS)
+    {
+	ASSERT (ret != GASPI_ERROR);
+	SUCCESS_OR_DIE (gaspi_queue_size (queue, &queue_size));
+	return (int) queue_size + num_req <= neighborhood_id->queue_size_max;
+    }
+
+    return 1;
+}
+
+
+int shan_comm_queue_reserve(shan_neighborhood_t *const neighborhood_id
+			    , gaspi_queue_id_t *const queue
+			    , int num_req
+    )
+{
+    int i;
+    int const num_queue = neighborhood_id->num_queue;
+    num_req = MIN(num_req, neighborhood_id->queue_size_max);
+
+    if (shan_comm_queue_room(neighborhood_id, *queue, num_req))
+    {
+	return 0;
+    }
+
+    /*
+     * spill to the next queue of the pool with room 
+     */
+    for (i = 1; i < num_queue; ++i)
+    {
+	gaspi_queue_id_t const spill = (gaspi_queue_id_t) ((*queue + i) % num_queue);
+	if (shan_comm_queue_room(neighborhood_id, spill, num_req))
+	{
+	    __sync_fetch_and_add(&(neighborhood_id->queue_spill), 1);
+	    *queue = spill;
+	    return 1;
+	}
+    }
+
+    /*
+     * all queues of the pool are full
+     */
+    __sync_fetch_and_add(&(neighborhood_id->queue_stall), 1);
+    SUCCESS_OR_DIE (gaspi_wait (*queue, GASPI_BLOCK));
+    return 1;
+}
+
+
+int shan_comm_set_queues(shan_neighborhood_t *const neighborhood_id
+			 , int num_queue
+			 , int queue_affinity
+    )
+{
+    int i;
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(num_queue >= 0);
+    ASSERT(queue_affinity == SHAN_QUEUE_NEIGHBOR 
+	   || queue_affinity == SHAN_QUEUE_TYPE
+	   || queue_affinity == SHAN_QUEUE_THREAD);
+
+    gaspi_number_t queue_num;
+    SUCCESS_OR_DIE (gaspi_queue_num (&queue_num));
+    if (num_queue == 0 || num_queue > (int) queue_num)
+    {
+	num_queue = (int) queue_num;
+    }
+
+    /* 
+     * drain old pool, (type, neighbor) queues change
+     */
+    if (neighborhood_id->num_queue > 0)
+    {
+	for (i = 0; i < neighborhood_id->num_queue; ++i)
+	{
+	    SUCCESS_OR_DIE (gaspi_wait ((gaspi_queue_id_t) i, GASPI_BLOCK));
+	}
+    }
+
+    gaspi_number_t queue_size_max;
+    SUCCESS_OR_DIE (gaspi_queue_size_max (&queue_size_max));
+
+    neighborhood_id->num_queue      = num_queue;
+    neighborhood_id->queue_affinity = queue_affinity;
+    neighborhood_id->queue_size_max = (int) queue_size_max;
+
+    return SHAN_SUCCESS;
+}
+
+
+/*
+ * node local ranks (MPI_COMM_SHM) of global ranks (MPI_COMM_ALL), 
+ * -1 for ranks on other nodes
+ */
+static void shan_comm_translate_ranks(shan_neighborhood_t const *const neighborhood_id
+				      , int const num
+				      , int const *const rank
+				      , int *const local_rank
+    )
+{
+    int i;
+    MPI_Group group_all, group_shm;
+    MPI_Comm_group(neighborhood_id->MPI_COMM_ALL, &group_all);
+    MPI_Comm_group(neighborhood_id->MPI_COMM_SHM, &group_shm);
+
+    MPI_Group_translate_ranks(group_all
+			      , num
+			      , (int *) rank
+			      , group_shm
+			      , local_rank
+	);
+    for (i = 0; i < num; ++i)
+    {
+	if (local_rank[i] == MPI_UNDEFINED)
+	{
+	    local_rank[i] = -1;
+	}
     }
 
+    MPI_Group_free(&group_shm);
+    MPI_Group_free(&group_all);
 }
 
+
 int shan_comm_local_rank(shan_neighborhood_t * const neighborhood_id
 		    , int const rank
 		    )
 {
-    int val = -1;
+    int i, val = -1;
     ASSERT(rank >= 0);
     ASSERT(rank < neighborhood_id->nProcGlobal);
   
-    if (neighborhood_id->master == neighborhood_id->remote_master[rank])
+    for (i = 0; i < neighborhood_id->num_neighbors; ++i)
     {
-	val = rank % neighborhood_id->nProcLocal;
+	if (neighborhood_id->neighbors[i] == rank)
+	{
+	    return neighborhood_id->local_rank[i];
+	}
     }    
+
+    /*
+     * not a neighbor, translate
+     */
+    shan_comm_translate_ranks(neighborhood_id
+			      , 1
+			      , &rank
+			      , &val
+	);
     return val;
 }
 
 
-#ifndef DEBUG
-static void shan_negotiate_meta_data(shan_neighborhood_t * const neighborhood_id)
+/*
+ * meta data per neighbor in the negotiation, 
+ * comm index, num neighbors, coalesced writes, then per type max 
+ * send / recv size, max send / recv elements, offset format and 
+ * buffer ring depth
+ */
+#define NELEM_META_HEADER 3
+#define NELEM_META_TYPE 6
+#define NELEM_META(num_type) (NELEM_META_HEADER + NELEM_META_TYPE * (num_type))
+
+static void shan_negotiate_meta_data(shan_neighborhood_t * const neighborhood_id
+				     , long const *maxSendSz
+				     , long const *maxRecvSz
+				     , int const *max_nelem_send
+				     , int const *max_nelem_recv
+    )
 {
-    int i;
-    int num_neighbors = neighborhood_id->num_neighbors;
+    int i, j;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type = neighborhood_id->num_type;
+    int const nmeta = NELEM_META(num_type);
+
     /*
-     * set rank local offsets and notifications
+     * neighborhood as distributed graph, in and out edges 
+     * are the neighbors in the order of the neighbor list.
+     * Unit weights rather than MPI_UNWEIGHTED, which some MPI headers
+     * declare as a sized array (-Wstringop-overread).
      */
-    neighborhood_id->RemoteNumNeighbors = check_malloc(num_neighbors * sizeof(int));
-    neighborhood_id->RemoteCommIndex = check_malloc(num_neighbors * sizeof(int));
+    int *weights = check_malloc(MAX(num_neighbors, 1) * sizeof(int));
+    for (i = 0; i < num_neighbors; ++i)
+    {
+	weights[i] = 1;
+    }
+    MPI_Dist_graph_create_adjacent(neighborhood_id->MPI_COMM_ALL
+				   , num_neighbors
+				   , neighborhood_id->neighbors
+				   , weights
+				   , num_neighbors
+				   , neighborhood_id->neighbors
+				   , weights
+				   , MPI_INFO_NULL
+				   , 0
+				   , &(neighborhood_id->MPI_COMM_GRAPH)
+	);
+    check_free(weights);
 
+    long *send_meta = check_malloc(num_neighbors * nmeta * sizeof(long));
+    long *recv_meta = check_malloc(num_neighbors * nmeta * sizeof(long));
     for (i = 0; i < num_neighbors; ++i)
     {
-	neighborhood_id->RemoteNumNeighbors[i] = 0;
-	neighborhood_id->RemoteCommIndex[i] = -1;   
+	long *meta = &(send_meta[i * nmeta]);
+	meta[0] = i;
+	meta[1] = num_neighbors;
+	meta[2] = neighborhood_id->coalesce;
+	for (j = 0; j < num_type; ++j)
+	{
+	    long *const type_meta = &(meta[NELEM_META_HEADER + NELEM_META_TYPE * j]);
+	    type_meta[0] = maxSendSz[j];
+	    type_meta[1] = maxRecvSz[j];
+	    type_meta[2] = max_nelem_send[j];
+	    type_meta[3] = max_nelem_recv[j];
+	    type_meta[4] = neighborhood_id->type_element[j].offset_format;
+	    type_meta[5] = neighborhood_id->type_element[j].num_buffer;
+	}
     }
-  
+
     /* 
-     * exchange remote comm idx
+     * exchange comm idx, num neighbors and sizes in one step
      */     
+    MPI_Neighbor_alltoall(send_meta
+			  , nmeta
+			  , MPI_LONG
+			  , recv_meta
+			  , nmeta
+			  , MPI_LONG
+			  , neighborhood_id->MPI_COMM_GRAPH
+	);
+
+    neighborhood_id->RemoteNumNeighbors = check_malloc(num_neighbors * sizeof(int));
+    neighborhood_id->RemoteCommIndex = check_malloc(num_neighbors * sizeof(int));
+    neighborhood_id->RemoteMaxSendSz = check_malloc(num_neighbors * num_type * sizeof(long));
+    neighborhood_id->RemoteMaxRecvSz = check_malloc(num_neighbors * num_type * sizeof(long));
+    neighborhood_id->RemoteMaxNelemSend = check_malloc(num_neighbors * num_type * sizeof(int));
+    neighborhood_id->RemoteMaxNelemRecv = check_malloc(num_neighbors * num_type * sizeof(int));
+
     for (i = 0; i < num_neighbors; ++i)
     {
-	int const rank = neighborhood_id->neighbors[i];
-	local_exchange_comm(neighborhood_id->iProcGlobal
-			    , rank
-			    , sizeof(int)
-			    , &i
-			    , &(neighborhood_id->RemoteCommIndex[i])
-			    , neighborhood_id->MPI_COMM_ALL
-	    );
-      
-	local_exchange_comm(neighborhood_id->iProcGlobal
-			    , rank
-			    , sizeof(int)
-			    , &num_neighbors
-			    , &(neighborhood_id->RemoteNumNeighbors[i])
-			    , neighborhood_id->MPI_COMM_ALL
-	    );
-    }     
-}
-#else
-static void shan_negotiate_meta_data(shan_neighborhood_t * const neighborhood_id)
-{
-    int i;
-    int num_neighbors = neighborhood_id->num_neighbors;
-    /* 
-     * exchange remote num_neighbors
-     */	  
-    int *tmp1 = check_malloc (neighborhood_id->nProcGlobal * sizeof(int));  
-    MPI_Allgather(&(neighborhood_id->num_neighbors)
-		  , 1
-		  , MPI_INT
-		  , tmp1
-		  , 1
-		  , MPI_INT
-		  , neighborhood_id->MPI_COMM_ALL
-	);  
+	long const *meta = &(recv_meta[i * nmeta]);
+	neighborhood_id->RemoteCommIndex[i] = (int) meta[0];
+	neighborhood_id->RemoteNumNeighbors[i] = (int) meta[1];
+	ASSERT(meta[0] >= 0 && meta[0] < meta[1]);
+
+	/*
+	 * coalesced writes are only seen by receivers 
+	 * polling the coalesced notifications
+	 */
+	ASSERT(meta[2] == neighborhood_id->coalesce);
+	for (j = 0; j < num_type; ++j)
+	{
+	    long const *const type_meta = &(meta[NELEM_META_HEADER + NELEM_META_TYPE * j]);
+	    neighborhood_id->RemoteMaxSendSz[i * num_type + j]    = type_meta[0];
+	    neighborhood_id->RemoteMaxRecvSz[i * num_type + j]    = type_meta[1];
+	    neighborhood_id->RemoteMaxNelemSend[i * num_type + j] = (int) type_meta[2];
+	    neighborhood_id->RemoteMaxNelemRecv[i * num_type + j] = (int) type_meta[3];
+
+	    /*
+	     * node local neighbors read our shared type (and we theirs)
+	     * with the own format, has to match per comm pair
+	     */
+	    ASSERT(type_meta[4] == neighborhood_id->type_element[j].offset_format);
+
+	    /*
+	     * buffer rings and notification ids of a pair are 
+	     * laid out with the same depth on both sides
+	     */
+	    ASSERT(type_meta[5] == neighborhood_id->type_element[j].num_buffer);
+	}
+    }
 
-    neighborhood_id->RemoteNumNeighbors = check_malloc(num_neighbors * sizeof(int));
+#ifdef DEBUG
+    /*
+     * check symmetry, neighbor i must list us at RemoteCommIndex[i]
+     */
     for (i = 0; i < num_neighbors; ++i)
     {
-	int const rank = neighborhood_id->neighbors[i];
-	neighborhood_id->RemoteNumNeighbors[i] = tmp1[rank];
-    }	  
+	send_meta[i * nmeta] = neighborhood_id->RemoteCommIndex[i];
+    }
+    MPI_Neighbor_alltoall(send_meta
+			  , nmeta
+			  , MPI_LONG
+			  , recv_meta
+			  , nmeta
+			  , MPI_LONG
+			  , neighborhood_id->MPI_COMM_GRAPH
+	);
+    for (i = 0; i < num_neighbors; ++i)
+    {
+	ASSERT(recv_meta[i * nmeta] == i);
+    }
+#endif
 
-    /* 
-     * exchange remote neighbors
-     */	  
-    int *tmp2 = check_malloc (neighborhood_id->nProcGlobal * sizeof(int));  
-    int ncomm = 0;
-    for (i = 0; i < neighborhood_id->nProcGlobal; ++i)
-    {
-	tmp2[i] = ncomm;
-	ncomm += tmp1[i];
-    }	  
+    check_free(recv_meta);
+    check_free(send_meta);
+}
 
-    int *tmp3 = check_malloc (ncomm * sizeof(int));  
-    MPI_Allgatherv(neighborhood_id->neighbors
-		   , neighborhood_id->num_neighbors
-		   , MPI_INT
-		   , tmp3
-		   , tmp1
-		   , tmp2
-		   , MPI_INT
-		   , neighborhood_id->MPI_COMM_ALL
-	);  
 
+/*
+ * buffers are packed with per pair sizes, i.e. the remote segment 
+ * layout is not known to the neighbors. Exchange the offsets of 
+ * the recv buffer rings, per type.
+ */
+static void shan_negotiate_layout(shan_neighborhood_t * const neighborhood_id)
+{
+    int i, j;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type = neighborhood_id->num_type;
 
-    /* 
-     * exchange remote comm idx
-     */	  
-    neighborhood_id->RemoteCommIndex = check_malloc(num_neighbors * sizeof(int));
+    long *send_meta = check_malloc(2 * num_neighbors * num_type * sizeof(long));
+    long *recv_meta = check_malloc(2 * num_neighbors * num_type * sizeof(long));
     for (i = 0; i < num_neighbors; ++i)
     {
-	neighborhood_id->RemoteCommIndex[i] = -1;	  
+	for (j = 0; j < num_type; ++j)
+	{
+	    send_meta[(2 * i) * num_type + j]     = neighborhood_id->type_element[j].RecvOffset[i];
+	    send_meta[(2 * i + 1) * num_type + j] = neighborhood_id->type_element[j].SendOffset[i];
+	}
     }
-  
-    for (i = 0; i < num_neighbors; ++i)
+
+    MPI_Neighbor_alltoall(send_meta
+			  , 2 * num_type
+			  , MPI_LONG
+			  , recv_meta
+			  , 2 * num_type
+			  , MPI_LONG
+			  , neighborhood_id->MPI_COMM_GRAPH
+	);
+
+    for (j = 0; j < num_type; ++j)
     {
-	int const rank = neighborhood_id->neighbors[i];
-	int j, bdir = 0;
-	for (j = 0; j < tmp1[rank]; ++j)
+	shan_element_t *const type_element = &(neighborhood_id->type_element[j]);
+	type_element->RemoteRecvOffset = check_malloc(num_neighbors * sizeof(long));
+	type_element->RemoteSendOffset = check_malloc(num_neighbors * sizeof(long));
+	for (i = 0; i < num_neighbors; ++i)
 	{
-	    if (tmp3[tmp2[rank]+j] == neighborhood_id->iProcGlobal)
-	    {
-		neighborhood_id->RemoteCommIndex[i] = j;	  
-		bdir = 1;
-		break;
-	    }
+	    type_element->RemoteRecvOffset[i] = recv_meta[(2 * i) * num_type + j];
+	    type_element->RemoteSendOffset[i] = recv_meta[(2 * i + 1) * num_type + j];
 	}
-	ASSERT(bdir == 1);
     }
-	    
-    check_free(tmp3);
-    check_free(tmp2);
-    check_free(tmp1);
 
+    check_free(recv_meta);
+    check_free(send_meta);
+}
+
+
+/*
+ * synchronization with neighbors only
+ */
+static void shan_comm_neighbor_sync(shan_neighborhood_t * const neighborhood_id)
+{
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int *sync = check_malloc(num_neighbors * sizeof(int));
+    int i = 0;
+    MPI_Neighbor_allgather(&i
+			   , 1
+			   , MPI_INT
+			   , sync
+			   , 1
+			   , MPI_INT
+			   , neighborhood_id->MPI_COMM_GRAPH
+	);
+    check_free(sync);
 }
-#endif
 
 
 
-int shan_comm_free_comm(shan_neighborhood_t *const neighborhood_id)
+/*
+ * per neighbor comm state of all types: counters, copy plans, 
+ * comm handles and buffer layout
+ */
+static void shan_comm_free_state(shan_neighborhood_t *const neighborhood_id)
 {
-    int i;
+    int i, j;
     for (i = 0; i < neighborhood_id->num_type; ++i)
     {
 	check_free(neighborhood_id->type_element[i].local_recv_count);
 	check_free(neighborhood_id->type_element[i].local_send_count);
 	check_free(neighborhood_id->type_element[i].local_ack_count);
+	check_free(neighborhood_id->type_element[i].zero_copy_pending);
+	check_free(neighborhood_id->type_element[i].direct_count);
+	check_free(neighborhood_id->type_element[i].pull_count);
+	check_free(neighborhood_id->type_element[i].local_stage_count);
+	check_free(neighborhood_id->type_element[i].batch_prev);
+	check_free(neighborhood_id->type_element[i].batch_seen);
+	check_free((int *) neighborhood_id->type_element[i].batch_ready);
+	check_free(neighborhood_id->type_element[i].mailbox_pending);
+
+	for (j = 0; j < neighborhood_id->num_neighbors; ++j)
+	{
+	    check_free(neighborhood_id->type_element[i].handle[j].send_buffer);
+	    check_free(neighborhood_id->type_element[i].handle[j].recv_buffer);
+	    check_free(neighborhood_id->type_element[i].handle[j].remote_recv_buffer);
+	    check_free(neighborhood_id->type_element[i].handle[j].remote_send_buffer);
+	    check_free(neighborhood_id->type_element[i].handle[j].notify_id);
+	    shan_copy_plan_free(&(neighborhood_id->type_element[i].send_plan[j]));
+	    shan_copy_plan_free(&(neighborhood_id->type_element[i].recv_plan[j]));
+	    shan_copy_plan_free(&(neighborhood_id->type_element[i].local_plan[j]));
+	    shan_copy_plan_free(&(neighborhood_id->type_element[i].push_plan[j]));
+	}
+	check_free(neighborhood_id->type_element[i].send_plan);
+	check_free(neighborhood_id->type_element[i].recv_plan);
+	check_free(neighborhood_id->type_element[i].local_plan);
+	check_free(neighborhood_id->type_element[i].push_plan);
+	check_free(neighborhood_id->type_element[i].stats);
+	check_free(neighborhood_id->type_element[i].handle);
+	check_free(neighborhood_id->type_element[i].SendSz);
+	check_free(neighborhood_id->type_element[i].RecvSz);
+	check_free(neighborhood_id->type_element[i].SendOffset);
+	check_free(neighborhood_id->type_element[i].RecvOffset);
+	check_free(neighborhood_id->type_element[i].RemoteRecvOffset);
+	check_free(neighborhood_id->type_element[i].RemoteSendOffset);
     }
 
-    check_free(neighborhood_id->type_element);
-
     check_free(neighborhood_id->neighbors);
-    check_free(neighborhood_id->remote_master);
+    check_free(neighborhood_id->local_rank);
+    check_free(neighborhood_id->direct_segment);
+    check_free(neighborhood_id->signal_send_count);
+    check_free(neighborhood_id->signal_recv_count);
+    check_free(neighborhood_id->signal_seen);
     check_free(neighborhood_id->RemoteNumNeighbors);
     check_free(neighborhood_id->RemoteCommIndex );
+    check_free(neighborhood_id->RemoteMaxSendSz);
+    check_free(neighborhood_id->RemoteMaxRecvSz);
+    check_free(neighborhood_id->RemoteMaxNelemSend);
+    check_free(neighborhood_id->RemoteMaxNelemRecv);
+}
+
+
+/*
+ * per rank table of the communication statistics
+ */
+static void shan_comm_dump_stats(shan_neighborhood_t *const neighborhood_id)
+{
+    int i, j;
+    for (i = 0; i < neighborhood_id->num_type; ++i)
+    {
+	for (j = 0; j < neighborhood_id->num_neighbors; ++j)
+	{
+	    shan_stats_t stats;
+	    shan_comm_get_stats(neighborhood_id
+				, i
+				, j
+				, &stats
+		);
+	    printf("SHAN stats rank %6d type %3d nbr %6d %s"
+		   " send %8ld %12ld B recv %8ld %12ld B"
+		   " wait send %10.6f s recv %10.6f s queue full %ld\n"
+		   , neighborhood_id->iProcGlobal
+		   , i
+		   , neighborhood_id->neighbors[j]
+		   , stats.local ? "local " : "remote"
+		   , stats.num_send
+		   , stats.bytes_send
+		   , stats.num_recv
+		   , stats.bytes_recv
+		   , stats.wait_send
+		   , stats.wait_recv
+		   , stats.queue_full
+		);
+	}
+    }
+    printf("SHAN stats rank %6d queue spill %ld stall %ld\n"
+	   , neighborhood_id->iProcGlobal
+	   , neighborhood_id->queue_spill
+	   , neighborhood_id->queue_stall
+	);
+    fflush(stdout);
+}
+
+
+int shan_comm_free_comm(shan_neighborhood_t *const neighborhood_id)
+{
+    int i;
+    if (neighborhood_id->stats_dump)
+    {
+	shan_comm_dump_stats(neighborhood_id);
+    }
+    shan_comm_free_state(neighborhood_id);
+    check_free(neighborhood_id->type_element);
 
     shan_segment_t *shared_segment = &(neighborhood_id->shared_segment);
     shan_free_shared(shared_segment);
 
-    SUCCESS_OR_DIE (gaspi_wait (0, GASPI_BLOCK));
-    MPI_Barrier(neighborhood_id->MPI_COMM_ALL);
+    for (i = 0; i < neighborhood_id->num_queue; ++i)
+    {
+	SUCCESS_OR_DIE (gaspi_wait ((gaspi_queue_id_t) i, GASPI_BLOCK));
+    }
+    /*
+     * neighbors are done with our segment
+     */
+    shan_comm_neighbor_sync(neighborhood_id);
+    MPI_Comm_free(&(neighborhood_id->MPI_COMM_GRAPH));
 
     SUCCESS_OR_DIE(gaspi_segment_delete(neighborhood_id->neighbor_hood_id));
     shan_remote_t *remote_segment  = &(neighborhood_id->remote_segment);
@@ -428,176 +1239,146 @@ int shan_comm_free_comm(shan_neighborhood_t *const neighborhood_id)
 
 }
 
-int shan_comm_init_comm(shan_neighborhood_t *const neighborhood_id
-			, int neighbor_hood_id
-			, int *neighbors
-			, int num_neighbors
-			, long *maxSendSz
-			, long *maxRecvSz
-			, int *max_nelem_send
-			, int *max_nelem_recv
-			, int num_type 
-			, MPI_Comm MPI_COMM_SHM
-			, MPI_Comm MPI_COMM_ALL
-			)
-{
-    int i, j, k;
-    ASSERT(neighborhood_id != NULL);
-    ASSERT(neighbors != NULL);
-    ASSERT(num_neighbors > 0);
-
-    ASSERT(maxSendSz != NULL);
-    ASSERT(maxRecvSz != NULL);
-    ASSERT(max_nelem_send != NULL);
-    ASSERT(max_nelem_recv != NULL);
-    ASSERT(num_type > 0);
-
-    ASSERT(MPI_COMM_SHM != MPI_COMM_NULL);
-    ASSERT(MPI_COMM_ALL != MPI_COMM_NULL);
-
-    neighborhood_id->neighbor_hood_id = neighbor_hood_id;
-
-    neighborhood_id->MPI_COMM_SHM = MPI_COMM_SHM;
-    neighborhood_id->MPI_COMM_ALL = MPI_COMM_ALL;
-  
-    MPI_Comm_rank(MPI_COMM_SHM, &(neighborhood_id->iProcLocal));
-    MPI_Comm_size(MPI_COMM_SHM, &(neighborhood_id->nProcLocal));
-
-    MPI_Comm_rank(MPI_COMM_ALL, &(neighborhood_id->iProcGlobal));
-    MPI_Comm_size(MPI_COMM_ALL, &(neighborhood_id->nProcGlobal));
 
-    neighborhood_id->master = neighborhood_id->iProcGlobal;
-    MPI_Bcast(&(neighborhood_id->master)
-	      , 1
-	      , MPI_INT
-	      , 0
-	      , neighborhood_id->MPI_COMM_SHM
-	);
-  
-    neighborhood_id->remote_master
-	= check_malloc (neighborhood_id->nProcGlobal * sizeof(int));
-  
-    MPI_Allgather(&(neighborhood_id->master)
-		  , 1
-		  , MPI_INT
-		  , neighborhood_id->remote_master
-		  , 1
-		  , MPI_INT
-		  , neighborhood_id->MPI_COMM_ALL
-	);  
-    ASSERT(neighborhood_id->remote_master[neighborhood_id->iProcGlobal]
-	   == neighborhood_id->master);
-  
+/*
+ * neighbor list and node locality of neighbors
+ */
+static void shan_comm_set_neighbors(shan_neighborhood_t *const neighborhood_id
+				    , int const *const neighbors
+				    , int const num_neighbors
+    )
+{
+    int i;
     neighborhood_id->num_neighbors = num_neighbors;
     neighborhood_id->neighbors = check_malloc(num_neighbors * sizeof(int));
-    neighborhood_id->local_stage_count = check_malloc(num_neighbors * sizeof(int));
+    neighborhood_id->direct_segment = check_malloc(num_neighbors * sizeof(int));
+    neighborhood_id->local_rank = check_malloc(num_neighbors * sizeof(int));
+    neighborhood_id->signal_send_count = check_malloc(num_neighbors * sizeof(int));
+    neighborhood_id->signal_recv_count = check_malloc(num_neighbors * sizeof(int));
+    neighborhood_id->signal_seen = check_malloc(num_neighbors * sizeof(int));
   
     for (i = 0; i < num_neighbors; ++i)
     {
 	ASSERT(neighbors[i] >= 0);
 	neighborhood_id->neighbors[i] = neighbors[i];
-	neighborhood_id->local_stage_count[i] = 0;
+	neighborhood_id->direct_segment[i] = -1;
+	neighborhood_id->signal_send_count[i] = 0;
+	neighborhood_id->signal_recv_count[i] = 0;
+	neighborhood_id->signal_seen[i] = 0;
     }
 
+    /*
+     * node locality of neighbors, independent of rank placement
+     */
+    shan_comm_translate_ranks(neighborhood_id
+			      , num_neighbors
+			      , neighborhood_id->neighbors
+			      , neighborhood_id->local_rank
+	);
+
     neighborhood_id->num_local  = 0;
     for (i = 0; i < neighborhood_id->num_neighbors; ++i)
     {
-	int const rank = neighborhood_id->neighbors[i];
-	if(shan_comm_local_rank(neighborhood_id
-				, rank
-	       ) == -1)
+	if (neighborhood_id->local_rank[i] != -1)
 	{
 	    neighborhood_id->num_local++;
 	}
     }  
+}
 
-    neighborhood_id->num_type = num_type;
 
+/*
+ * remote segment and shared type layout, from own and negotiated 
+ * remote max sizes. Returns the size of the shared type region.
+ */
+static long shan_comm_layout(shan_neighborhood_t *const neighborhood_id
+			     , long const *maxSendSz
+			     , long const *maxRecvSz
+			     , int const *max_nelem_send
+			     , int const *max_nelem_recv
+    )
+{
+    int i, j;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type = neighborhood_id->num_type;
+    int const page_size = sysconf (_SC_PAGESIZE);
+    int const max_header_len = NELEM_COMM_HEADER * sizeof(int);
 
-    /*
-     * negotiate remote comm index
+    /* 
+     * direct receive descriptors first, i.e. at offsets 
+     * which only depend on the number of neighbors
      */
-    shan_negotiate_meta_data(neighborhood_id);
+    long remoteSz = NUM_DIRECT_SLOT * num_type * num_neighbors * sizeof(shan_direct_t);
+    remoteSz = UP(remoteSz, ALIGNMENT);
 
-  
     /* 
-     * global max comm sizes 
+     * send / recv buffers, packed per neighbor. A buffer holds 
+     * the smaller of the max sizes of sender and receiver.
      */
-    MPI_Allreduce( MPI_IN_PLACE
-		   , maxSendSz
-		   , num_type
-		   , MPI_LONG
-		   , MPI_MAX
-		   , neighborhood_id->MPI_COMM_ALL
-	);
-
-    MPI_Allreduce( MPI_IN_PLACE
-		   , maxRecvSz
-		   , num_type
-		   , MPI_LONG
-		   , MPI_MAX
-		   , neighborhood_id->MPI_COMM_ALL
-	);
-  
-    /* 
-     * global max elements
-     */
-    MPI_Allreduce( MPI_IN_PLACE
-		   , max_nelem_send
-		   , num_type
-		   , MPI_INT
-		   , MPI_MAX
-		   , neighborhood_id->MPI_COMM_ALL
-	);
-
-    MPI_Allreduce( MPI_IN_PLACE
-		   , max_nelem_recv
-		   , num_type
-		   , MPI_INT
-		   , MPI_MAX
-		   , neighborhood_id->MPI_COMM_ALL
-	);
-
-    int const page_size = sysconf (_SC_PAGESIZE);
-    neighborhood_id->type_element
-	= check_malloc(num_type * sizeof(shan_element_t));    
-  
-
-    int const max_header_len = NELEM_COMM_HEADER * sizeof(int);
-    long remoteSz = 0;
     for (i = 0; i < num_type; ++i)
     {
-	long sz = maxSendSz[i] + max_header_len;
-	sz = UP(sz, ALIGNMENT);
-	neighborhood_id->type_element[i].maxSendSz    = sz;
-	neighborhood_id->type_element[i].max_nelem_send = max_nelem_send[i];
-	neighborhood_id->type_element[i].SendOffset[0] = remoteSz;
-	neighborhood_id->type_element[i].SendOffset[1] = remoteSz + sz;
-	remoteSz += 2 * sz;
+	shan_element_t *const type_element = &(neighborhood_id->type_element[i]);
+	type_element->maxSendSz      = UP(maxSendSz[i] + max_header_len, ALIGNMENT);
+	type_element->max_nelem_send = max_nelem_send[i];
+	type_element->SendSz         = check_malloc(num_neighbors * sizeof(long));
+	type_element->SendOffset     = check_malloc(num_neighbors * sizeof(long));
+	for (j = 0; j < num_neighbors; ++j)
+	{
+	    long sz = MIN(maxSendSz[i], neighborhood_id->RemoteMaxRecvSz[j * num_type + i]);
+	    sz = UP(sz + max_header_len, ALIGNMENT);
+	    type_element->SendSz[j]     = sz;
+	    type_element->SendOffset[j] = remoteSz;
+	    remoteSz += type_element->num_buffer * sz;
+	}
     }
     for (i = 0; i < num_type; ++i)
     {
-	long sz = maxRecvSz[i] + max_header_len;
-	sz = UP(sz, ALIGNMENT);
-	neighborhood_id->type_element[i].maxRecvSz    = sz;
-	neighborhood_id->type_element[i].max_nelem_recv = max_nelem_recv[i];
-	neighborhood_id->type_element[i].RecvOffset[0] = remoteSz;
-	neighborhood_id->type_element[i].RecvOffset[1] = remoteSz + sz;
-	remoteSz += 2 * sz;
+	shan_element_t *const type_element = &(neighborhood_id->type_element[i]);
+	type_element->maxRecvSz      = UP(maxRecvSz[i] + max_header_len, ALIGNMENT);
+	type_element->max_nelem_recv = max_nelem_recv[i];
+	type_element->RecvSz         = check_malloc(num_neighbors * sizeof(long));
+	type_element->RecvOffset     = check_malloc(num_neighbors * sizeof(long));
+	for (j = 0; j < num_neighbors; ++j)
+	{
+	    long sz = MIN(maxRecvSz[i], neighborhood_id->RemoteMaxSendSz[j * num_type + i]);
+	    sz = UP(sz + max_header_len, ALIGNMENT);
+	    type_element->RecvSz[j]     = sz;
+	    type_element->RecvOffset[j] = remoteSz;
+	    remoteSz += type_element->num_buffer * sz;
+	}
     }	  
-    neighborhood_id->remoteSz = UP(num_neighbors * remoteSz, page_size);
+    neighborhood_id->commSz = remoteSz;
+    neighborhood_id->remoteSz = UP(remoteSz, page_size);
+
+    /* 
+     * recv (and send) buffer offsets in the segments of the neighbors
+     */
+    shan_negotiate_layout(neighborhood_id);
   
+    /* 
+     * shared type, sized by own max elements
+     */
     long elemOffset = 0;
     for (i = 0; i < num_type; ++i)
     {
-	neighborhood_id->type_element[i].elemOffset = elemOffset;
-	elemOffset += MAX_SHARED_NOTIFICATION * sizeof(shan_notification_t)
-	    + 4 * sizeof(int) + (max_nelem_send[i] + max_nelem_recv[i]) * sizeof(long);
+	shan_element_t *const type_element = &(neighborhood_id->type_element[i]);
+	type_element->elemOffset = elemOffset;
+	elemOffset += TYPE_ELEM_SZ(max_nelem_send[i], max_nelem_recv[i], type_element->offset_format);
     }
-    long const typeOffset = UP(num_neighbors * elemOffset, page_size);
 
-  
-    for (i = 0; i < num_type; ++i)
+    return UP(SYNC_SZ(num_neighbors) + num_type * MAILBOX_SZ(num_neighbors) 
+	      + num_neighbors * elemOffset, page_size);
+}
+
+
+/*
+ * per neighbor counters, copy plans and comm handles of all types
+ */
+static void shan_comm_alloc_state(shan_neighborhood_t *const neighborhood_id)
+{
+    int i, j, k;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    for (i = 0; i < neighborhood_id->num_type; ++i)
     {
 	neighborhood_id->type_element[i].local_recv_count
 	    = check_malloc(num_neighbors *sizeof(int));
@@ -605,36 +1386,91 @@ int shan_comm_init_comm(shan_neighborhood_t *const neighborhood_id
 	    = check_malloc(num_neighbors *sizeof(int));
 	neighborhood_id->type_element[i].local_ack_count
 	    = check_malloc(num_neighbors *sizeof(int));
+	neighborhood_id->type_element[i].zero_copy_pending
+	    = check_malloc(num_neighbors *sizeof(int));
+	neighborhood_id->type_element[i].direct_count
+	    = check_malloc(num_neighbors *sizeof(int));
+	neighborhood_id->type_element[i].pull_count
+	    = check_malloc(num_neighbors *sizeof(int));
+	neighborhood_id->type_element[i].local_stage_count
+	    = check_malloc(num_neighbors *sizeof(int));
+	neighborhood_id->type_element[i].batch_prev
+	    = check_malloc(num_neighbors *sizeof(int));
+	neighborhood_id->type_element[i].batch_seen
+	    = check_malloc(num_neighbors *sizeof(int));
+	neighborhood_id->type_element[i].batch_ready
+	    = check_malloc(neighborhood_id->type_element[i].num_buffer * num_neighbors *sizeof(int));
+	neighborhood_id->type_element[i].mailbox_pending
+	    = check_malloc(2 * MAILBOX_NWORD(num_neighbors) * sizeof(uint64_t));
+	for (k = 0; k < 2 * MAILBOX_NWORD(num_neighbors); ++k)
+	{
+	    neighborhood_id->type_element[i].mailbox_pending[k] = 0;
+	}
 
+	neighborhood_id->type_element[i].commit_count = 0;
+	neighborhood_id->type_element[i].send_plan
+	    = check_malloc(num_neighbors * sizeof(shan_copy_plan_t));
+	neighborhood_id->type_element[i].recv_plan
+	    = check_malloc(num_neighbors * sizeof(shan_copy_plan_t));
+	neighborhood_id->type_element[i].local_plan
+	    = check_malloc(num_neighbors * sizeof(shan_copy_plan_t));
+	neighborhood_id->type_element[i].push_plan
+	    = check_malloc(num_neighbors * sizeof(shan_copy_plan_t));
+	neighborhood_id->type_element[i].stats
+	    = check_malloc(num_neighbors * sizeof(shan_stats_t));
+	memset(neighborhood_id->type_element[i].stats, 0, num_neighbors * sizeof(shan_stats_t));
+	neighborhood_id->type_element[i].handle
+	    = check_malloc(num_neighbors * sizeof(shan_handle_t));
       
 	for (j = 0; j < num_neighbors; ++j)
 	{
 	    neighborhood_id->type_element[i].local_recv_count[j]  = 0;
 	    neighborhood_id->type_element[i].local_send_count[j]  = 0;
 	    neighborhood_id->type_element[i].local_ack_count[j]   = 0;
+	    neighborhood_id->type_element[i].zero_copy_pending[j] = 0;
+	    neighborhood_id->type_element[i].direct_count[j]      = 0;
+	    neighborhood_id->type_element[i].pull_count[j]        = 0;
+	    neighborhood_id->type_element[i].local_stage_count[j] = 0;
+	    neighborhood_id->type_element[i].batch_prev[j]        = 0;
+	    neighborhood_id->type_element[i].batch_seen[j]        = 0;
+	    for (k = 0; k < neighborhood_id->type_element[i].num_buffer; ++k)
+	    {
+		neighborhood_id->type_element[i].batch_ready[j * neighborhood_id->type_element[i].num_buffer + k] = 0;
+	    }
+	    shan_copy_plan_init(&(neighborhood_id->type_element[i].send_plan[j]));
+	    shan_copy_plan_init(&(neighborhood_id->type_element[i].recv_plan[j]));
+	    shan_copy_plan_init(&(neighborhood_id->type_element[i].local_plan[j]));
+	    shan_copy_plan_init(&(neighborhood_id->type_element[i].push_plan[j]));
 	}
     }
-  
-
-    /*
-     * allocate and bind remote comm segment 
-     */
-    shan_comm_alloc_comm(neighborhood_id);
-  
-    shan_segment_t *shared_segment = &(neighborhood_id->shared_segment);
-    int res = shan_alloc_shared(shared_segment
-				, neighborhood_id->neighbor_hood_id
-				, SHAN_TYPE
-				, typeOffset
-				, neighborhood_id->MPI_COMM_SHM
-	);
+}
 
 
-    ASSERT(res == SHAN_SUCCESS);
+/*
+ * reset own shared types, notifications, sizes and offsets
+ */
+static void shan_comm_init_types(shan_neighborhood_t *const neighborhood_id)
+{
+    int i, k;
+    int const num_neighbors = neighborhood_id->num_neighbors;
 
+    void *shm_ptr;
+    shan_get_shared_ptr(&(neighborhood_id->shared_segment)
+			, neighborhood_id->iProcLocal
+			, &shm_ptr);
+    for (k = 0; k < SHAN_SYNC_SIGNAL + num_neighbors; ++k)
+    {
+	shan_notify_init_shared((shan_notification_t *) shm_ptr
+				, k
+	    );
+    }
+    memset((char *) shm_ptr + SYNC_SZ(num_neighbors)
+	   , 0
+	   , neighborhood_id->num_type * MAILBOX_SZ(num_neighbors));
 
-    for (i = 0; i < num_type; ++i)
+    for (i = 0; i < neighborhood_id->num_type; ++i)
     {
+	shan_element_t *const type_element = &(neighborhood_id->type_element[i]);
 	type_local_t type_info;
 	shan_get_shared_type(&type_info
 			     , neighborhood_id
@@ -656,233 +1492,1215 @@ int shan_comm_init_comm(shan_neighborhood_t *const neighborhood_id
 	    type_info.nelem_recv[k] = 0;
 	    type_info.send_sz[k]    = 0;
 	    type_info.recv_sz[k]    = 0;
+	    type_info.send_version[k] = 0;
+	    type_info.nblock_send[k]  = 0;
+	    type_info.nblock_recv[k]  = 0;
+	    type_info.recv_version[k] = 0;
+	    type_info.recv_ready[k]   = 0;
+	    type_info.push_count[k]   = 0;
 	}
       
-	for (k = 0; k < num_neighbors * max_nelem_send[i]; ++k)
+	if (type_info.send_offset != NULL)
 	{
-	    type_info.send_offset[k]    = 0;
+	    for (k = 0; k < num_neighbors * type_element->max_nelem_send; ++k)
+	    {
+		type_info.send_offset[k]    = 0;
+	    }
+	    for (k = 0; k < num_neighbors * type_element->max_nelem_recv; ++k)
+	    {
+		type_info.recv_offset[k]    = 0;
+	    }
 	}
-      
-	for (k = 0; k < num_neighbors * max_nelem_recv[i]; ++k)
+	else
 	{
-	    type_info.recv_offset[k]    = 0;
+	    long const sz = num_neighbors 
+		* (type_element->max_nelem_send + type_element->max_nelem_recv)
+		* sizeof(shan_offset_block_t);
+	    memset(type_info.send_block, 0, sz);
 	}
 
     }
-  
-    return SHAN_SUCCESS;
 }
 
 
-int shan_comm_waitsome_local(shan_neighborhood_t *const neighborhood_id
-			     , int const type_id
-			     , int const idx
-    )
+int shan_comm_init_comm(shan_neighborhood_t *const neighborhood_id
+			, int neighbor_hood_id
+			, int *neighbors
+			, int num_neighbors
+			, long *maxSendSz
+			, long *maxRecvSz
+			, int *max_nelem_send
+			, int *max_nelem_recv
+			, int *offset_format
+			, int *num_buffer
+			, int num_type 
+			, MPI_Comm MPI_COMM_SHM
+			, MPI_Comm MPI_COMM_ALL
+			)
 {
-    int iProcRemote, id = -1;  
-    int const rank = neighborhood_id->neighbors[idx];
-    ASSERT((iProcRemote = shan_comm_local_rank(neighborhood_id
-					       , rank
-		)) != -1);
-    int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
-    int const RemoteNumNeighbors = neighborhood_id->RemoteNumNeighbors[idx];
-
-    int rval = -1;
-    shan_test_shared(neighborhood_id
-		     , iProcRemote
-		     , RemoteNumNeighbors
-		     , type_id
-		     , RemoteCommIdx
-		     , &rval
-	);
-
-    int recv_count 
-	= neighborhood_id->type_element[type_id].local_recv_count[idx];
+    int i;
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(neighbors != NULL);
+    ASSERT(num_neighbors > 0);
 
-    if (rval > recv_count)
-    {
-	ASSERT(rval == recv_count + 1);
-	id = idx;
-    }
-  
-    return (id == -1) ? -1 : SHAN_SUCCESS;
-}
+    ASSERT(maxSendSz != NULL);
+    ASSERT(maxRecvSz != NULL);
+    ASSERT(max_nelem_send != NULL);
+    ASSERT(max_nelem_recv != NULL);
+    ASSERT(num_type > 0);
 
+    ASSERT(MPI_COMM_SHM != MPI_COMM_NULL);
+    ASSERT(MPI_COMM_ALL != MPI_COMM_NULL);
 
-int shan_comm_waitsome_remote(shan_neighborhood_t *const neighborhood_id
-			      , int const type_id
-			      , int const idx
-    )
-{
-    int const iProcLocal    = neighborhood_id->iProcLocal;
-    int const num_neighbors = neighborhood_id->num_neighbors;
-    int const num_type      = neighborhood_id->num_type;
+    neighborhood_id->neighbor_hood_id = neighbor_hood_id;
 
-    int id = -1;      
-    int const sid 
-	= (neighborhood_id->type_element[type_id].local_recv_count[idx]) % 2;  
-    int const nid = GET_NOTIFICATION_ID(sid, num_type, type_id, num_neighbors, idx);
+    neighborhood_id->MPI_COMM_SHM = MPI_COMM_SHM;
+    neighborhood_id->MPI_COMM_ALL = MPI_COMM_ALL;
   
-    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
-    gaspi_notification_id_t tmp_id;
-    gaspi_notification_t nval;
-    gaspi_return_t ret;
-    if (( ret =
-	  gaspi_notify_waitsome (remote_segment->shan_id
-				 , nid
-				 , 1
-				 , &tmp_id
-				 , GASPI_TEST
-	      )
-	    ) == GASPI_SUCCESS)
-    {
-	SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
-					   , tmp_id
-					   , &nval
-			   )); 
-	int const remote_rank = nval - 1;
+    MPI_Comm_rank(MPI_COMM_SHM, &(neighborhood_id->iProcLocal));
+    MPI_Comm_size(MPI_COMM_SHM, &(neighborhood_id->nProcLocal));
 
-	type_local_t type_info;
-	shan_get_shared_type(&type_info
-			     , neighborhood_id
-			     , iProcLocal
-			     , neighborhood_id->num_neighbors
-			     , type_id
-	    );
+    MPI_Comm_rank(MPI_COMM_ALL, &(neighborhood_id->iProcGlobal));
+    MPI_Comm_size(MPI_COMM_ALL, &(neighborhood_id->nProcGlobal));
 
-	long comm_buffer_offset = num_neighbors * neighborhood_id->type_element[type_id].RecvOffset[sid]
-            + idx * neighborhood_id->type_element[type_id].maxRecvSz;
+    shan_comm_set_neighbors(neighborhood_id
+			    , neighbors
+			    , num_neighbors
+	);
 
-	void *comm_ptr = (char*) remote_segment->shan_ptr + comm_buffer_offset;
-	int *const comm_header = (int *) comm_ptr;
-	int const nelem_send   = *(comm_header);
-	int const send_sz      = *(comm_header + 1);
-	int const rval         = *(comm_header + 2);	
-	int const rank         = neighborhood_id->neighbors[idx];
+    neighborhood_id->num_type = num_type;
 
-	ASSERT(rank == remote_rank);
-	ASSERT(rval > neighborhood_id->type_element[type_id].local_recv_count[idx]);
-	ASSERT(neighborhood_id->type_element[type_id].local_recv_count[idx] <= rval + 2);
+    /*
+     * default queue pool
+     */
+    neighborhood_id->num_queue   = 0;
+    neighborhood_id->queue_stall = 0;
+    neighborhood_id->queue_spill = 0;
+    neighborhood_id->stats_dump  = 0;
+    neighborhood_id->direct_gaspi_id = -1;
+    shan_comm_set_queues(neighborhood_id
+			 , 0
+			 , SHAN_QUEUE_NEIGHBOR
+	);
 
-#ifdef USE_VARIABLE_MESSAGE_LEN
-	type_info.nelem_recv[idx] = nelem_send;
-	type_info.recv_sz[idx]    = send_sz;
-#else
-	ASSERT(type_info.nelem_recv[idx] == nelem_send);
-	ASSERT(type_info.recv_sz[idx] == send_sz);
-#endif
-	id = idx;
+    /*
+     * default wait policy, busy wait
+     */
+    shan_comm_set_wait_policy(neighborhood_id
+			      , SHAN_WAIT_SPIN
+			      , SHAN_WAIT_SPIN_COUNT
+	);
 
-    }
-    else
-    {
-	ASSERT (ret != GASPI_ERROR);
-    }
+    /*
+     * coalesced writes off, GASPI write list limit
+     */
+    gaspi_number_t list_max;
+    SUCCESS_OR_DIE(gaspi_rw_list_elem_max(&list_max));
+    neighborhood_id->write_list_max = MIN((int) list_max, SHAN_WRITE_LIST_MAX);
+    neighborhood_id->batch_lock = 0;
+    neighborhood_id->coalesce   = 0;
 
-    return (id == -1) ? -1 : SHAN_SUCCESS;
-}
+    /*
+     * serial unpack
+     */
+    shan_comm_set_unpack_team(neighborhood_id
+			      , 1
+			      , 0
+			      , NULL
+			      , NULL
+	);
 
 
+    neighborhood_id->type_element
+	= check_malloc(num_type * sizeof(shan_element_t));    
 
+    /* 
+     * offset format and remote buffer ring depth, 
+     * have to match per comm pair (checked below)
+     */
+    neighborhood_id->num_buffer_max = 0;
+    for (i = 0; i < num_type; ++i)
+    {
+	neighborhood_id->type_element[i].offset_format 
+	    = (offset_format != NULL) ? offset_format[i] : SHAN_OFFSET_INDEXED;
+	neighborhood_id->type_element[i].num_buffer
+	    = (num_buffer != NULL) ? num_buffer[i] : SHAN_NUM_BUFFER;
+	ASSERT(neighborhood_id->type_element[i].num_buffer >= 2);
+	neighborhood_id->type_element[i].stream_threshold 
+	    = shan_copy_stream_default(neighborhood_id->nProcLocal);
+	neighborhood_id->type_element[i].push = 0;
+	neighborhood_id->type_element[i].pull = 0;
+	neighborhood_id->type_element[i].direct = 0;
+	neighborhood_id->num_buffer_max 
+	    = MAX(neighborhood_id->num_buffer_max, neighborhood_id->type_element[i].num_buffer);
+    }
 
+    /*
+     * negotiate remote comm index and sizes with neighbors
+     */
+    shan_negotiate_meta_data(neighborhood_id
+			     , maxSendSz
+			     , maxRecvSz
+			     , max_nelem_send
+			     , max_nelem_recv
+	);
 
-int shan_comm_notify_or_write(shan_neighborhood_t *const neighborhood_id
-			      , shan_segment_t *const data_segment
-			      , int type_id
-			      , int idx
-    )
+    long const typeOffset = shan_comm_layout(neighborhood_id
+					     , maxSendSz
+					     , maxRecvSz
+					     , max_nelem_send
+					     , max_nelem_recv
+	);
 
-{
-    int const iProcLocal    = neighborhood_id->iProcLocal;
-    int const num_neighbors = neighborhood_id->num_neighbors;
-    int const num_type      = neighborhood_id->num_type;
-    int iProcRemote;
+    shan_comm_alloc_state(neighborhood_id);
 
-    ASSERT(idx >= 0);
-    ASSERT(idx < num_neighbors);
+    /*
+     * allocate and bind remote comm segment 
+     */
+    shan_comm_alloc_comm(neighborhood_id);
   
-    int const rank = neighborhood_id->neighbors[idx];
-    int const sid  
-	= (neighborhood_id->type_element[type_id].local_send_count[idx]) % 2;	    
-	
-    if ((iProcRemote = shan_comm_local_rank(neighborhood_id
-					    , rank
-	     )) != -1)
-    {
-	shan_increment_local(neighborhood_id
-			     , type_id
-			     , idx
-	    );      
+    shan_segment_t *shared_segment = &(neighborhood_id->shared_segment);
+    int res = shan_alloc_shared(shared_segment
+				, neighborhood_id->neighbor_hood_id
+				, SHAN_TYPE
+				, typeOffset
+				, neighborhood_id->MPI_COMM_SHM
+	);
+    ASSERT(res == SHAN_SUCCESS);
 
-	++(neighborhood_id->type_element[type_id].local_send_count[idx]);
-    }
-    else
+    shan_comm_init_types(neighborhood_id);
+
+    /*
+     * prepare comm handles, requires shared types of all local ranks
+     */
+    MPI_Barrier(neighborhood_id->MPI_COMM_SHM);
+    for (i = 0; i < num_type; ++i)
     {
-	int i;      
-	type_local_t type_info;
-	shan_get_shared_type(&type_info
-			     , neighborhood_id
-			     , iProcLocal
-			     , neighborhood_id->num_neighbors
-			     , type_id
+	shan_comm_type_prepare(neighborhood_id
+			       , i
 	    );
-      
-	int nelem_send     = type_info.nelem_send[idx];
-	int send_sz        = type_info.send_sz[idx];
-	long *send_offset  = type_info.send_offset
-	    + idx * neighborhood_id->type_element[type_id].max_nelem_send;
-      
-	void *data_ptr;
-	shan_get_shared_ptr(data_segment
-			    , iProcLocal
-			    , &data_ptr);
-
-	int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
-	int const RemoteNumNeighbors = neighborhood_id->RemoteNumNeighbors[idx];
+    }
 
-	const gaspi_offset_t offset_local  = 
-	    num_neighbors * neighborhood_id->type_element[type_id].SendOffset[sid]
-	    + idx * neighborhood_id->type_element[type_id].maxSendSz;
-      
-	const gaspi_offset_t offset_remote = 
-	    RemoteNumNeighbors * neighborhood_id->type_element[type_id].RecvOffset[sid]
-	    + RemoteCommIdx * neighborhood_id->type_element[type_id].maxRecvSz;
+    /*
+     * neighbors must not write or read before we are registered 
+     * and reset, no global barrier
+     */
+    shan_comm_neighbor_sync(neighborhood_id);
+  
+    return SHAN_SUCCESS;
+}
 
-	const gaspi_notification_id_t nid
-	    = GET_NOTIFICATION_ID(sid, num_type, type_id, RemoteNumNeighbors, RemoteCommIdx);
 
-	gaspi_number_t notification_num;
-	SUCCESS_OR_DIE(gaspi_notification_num (&notification_num));
-	ASSERT(nid < (int) notification_num);
-      
-	shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
-	void *comm_ptr = (char*) remote_segment->shan_ptr + offset_local;
-	
-	if (nelem_send > 0)
-	{
-	    for (i = 0; i < nelem_send; ++i)
-	    {	      
-		void *restrict dest = (char*) comm_ptr 
-		    + NELEM_COMM_HEADER * sizeof(int) + i * send_sz;
-		void *restrict src  = (char*) data_ptr + send_offset[i];
-		memcpy(dest, src, send_sz);
+int shan_comm_update_comm(shan_neighborhood_t *const neighborhood_id
+			  , int *neighbors
+			  , int num_neighbors
+			  , long *maxSendSz
+			  , long *maxRecvSz
+			  , int *max_nelem_send
+			  , int *max_nelem_recv
+    )
+{
+    int i, j;
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(neighbors != NULL);
+    ASSERT(num_neighbors > 0);
+
+    ASSERT(maxSendSz != NULL);
+    ASSERT(maxRecvSz != NULL);
+    ASSERT(max_nelem_send != NULL);
+    ASSERT(max_nelem_recv != NULL);
+
+    int const num_type = neighborhood_id->num_type;
+    gaspi_segment_id_t const segment_id = neighborhood_id->neighbor_hood_id;
+
+    /*
+     * remote writes of the old neighborhood have to be complete
+     */
+    for (i = 0; i < neighborhood_id->num_queue; ++i)
+    {
+	SUCCESS_OR_DIE (gaspi_wait ((gaspi_queue_id_t) i, GASPI_BLOCK));
+    }
+
+    /*
+     * keep connections and direct receive registrations 
+     * of remaining neighbors
+     */
+    int const old_num_neighbors = neighborhood_id->num_neighbors;
+    int const old_notifications = NUM_NOTIFICATION(neighborhood_id->num_buffer_max
+						   , num_type
+						   , old_num_neighbors);
+    int *old_neighbors = check_malloc(old_num_neighbors * sizeof(int));
+    int *old_direct_segment = check_malloc(old_num_neighbors * sizeof(int));
+    for (j = 0; j < old_num_neighbors; ++j)
+    {
+	old_neighbors[j] = neighborhood_id->neighbors[j];
+	old_direct_segment[j] = neighborhood_id->direct_segment[j];
+    }
+
+    shan_comm_free_state(neighborhood_id);
+    MPI_Comm_free(&(neighborhood_id->MPI_COMM_GRAPH));
+
+    shan_comm_set_neighbors(neighborhood_id
+			    , neighbors
+			    , num_neighbors
+	);
+
+    int *connected = check_malloc(num_neighbors * sizeof(int));
+    for (i = 0; i < num_neighbors; ++i)
+    {
+	connected[i] = 0;
+	for (j = 0; j < old_num_neighbors; ++j)
+	{
+	    if (old_neighbors[j] == neighbors[i])
+	    {
+		connected[i] = 1;
+		neighborhood_id->direct_segment[i] = old_direct_segment[j];
+		break;
 	    }
 	}
+    }
+    check_free(old_direct_segment);
+    check_free(old_neighbors);
+
+    /*
+     * renegotiate with neighbors only, format and ring depth are kept
+     */
+    shan_negotiate_meta_data(neighborhood_id
+			     , maxSendSz
+			     , maxRecvSz
+			     , max_nelem_send
+			     , max_nelem_recv
+	);
+
+    long const typeOffset = shan_comm_layout(neighborhood_id
+					     , maxSendSz
+					     , maxRecvSz
+					     , max_nelem_send
+					     , max_nelem_recv
+	);
+
+    shan_comm_alloc_state(neighborhood_id);
+
+    /*
+     * remote comm segment, rebind only if it has to grow
+     */
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+    int const rebound = (neighborhood_id->remoteSz > remote_segment->dataSz);
+    if (rebound)
+    {
+	SUCCESS_OR_DIE(gaspi_segment_delete(segment_id));
+	shan_free_remote(remote_segment);
+	int res = shan_alloc_remote(remote_segment
+				    , segment_id
+				    , neighborhood_id->remoteSz
+	    );
+	ASSERT(res == SHAN_SUCCESS);
+	SUCCESS_OR_DIE (gaspi_segment_bind(segment_id
+					   , (gaspi_pointer_t) remote_segment->shan_ptr
+					   , (gaspi_size_t) remote_segment->dataSz
+					   , GASPI_PROC_LOCAL
+			    ));
+    }
+    shan_comm_register_remote(neighborhood_id
+			      , segment_id
+			      , connected
+			      , rebound
+	);
+    check_free(connected);
+
+    /*
+     * direct receive data for new neighbors
+     */
+    shan_comm_register_direct(neighborhood_id);
+
+    memset((char*) remote_segment->shan_ptr
+	   , 0
+	   , remote_segment->dataSz
+	);
+    shan_comm_reset_notifications(neighborhood_id
+				  , old_notifications
+	);
+
+    /*
+     * shared types, reallocated (node wide) only if a local rank has to grow
+     */
+    shan_segment_t *const shared_segment = &(neighborhood_id->shared_segment);
+    int grow = (typeOffset > shared_segment->localDataSz[neighborhood_id->iProcLocal]);
+    MPI_Allreduce( MPI_IN_PLACE
+		   , &grow
+		   , 1
+		   , MPI_INT
+		   , MPI_MAX
+		   , neighborhood_id->MPI_COMM_SHM
+	);
+    if (grow)
+    {
+	shan_free_shared(shared_segment);
+	int res = shan_alloc_shared(shared_segment
+				    , neighborhood_id->neighbor_hood_id
+				    , SHAN_TYPE
+				    , typeOffset
+				    , neighborhood_id->MPI_COMM_SHM
+	    );
+	ASSERT(res == SHAN_SUCCESS);
+    }
+
+    shan_comm_init_types(neighborhood_id);
+
+    /*
+     * shared barrier of local rank 0 has been reset
+     */
+    MPI_Barrier(neighborhood_id->MPI_COMM_SHM);
+    for (i = 0; i < num_type; ++i)
+    {
+	shan_comm_type_prepare(neighborhood_id
+			       , i
+	    );
+    }
+
+    /*
+     * neighbors must not write or read before we are reset
+     */
+    shan_comm_neighbor_sync(neighborhood_id);
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_waitsome_local(shan_neighborhood_t *const neighborhood_id
+			     , int const type_id
+			     , int const idx
+    )
+{
+    int id = -1;  
+    int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
+
+    /*
+     * own mailbox first, the notification of the 
+     * neighbor is only read if its bit is set
+     */
+    if (!shan_mailbox_test(neighborhood_id
+			   , type_id
+			   , idx
+			   , SHAN_MAILBOX_RECV
+	    ))
+    {
+	return -1;
+    }
+
+    int rval = -1;
+    shan_test_shared(neighborhood_id
+		     , type_id
+		     , idx
+		     , RemoteCommIdx
+		     , &rval
+	);
+
+    int recv_count 
+	= neighborhood_id->type_element[type_id].local_recv_count[idx];
+
+    if (rval > recv_count)
+    {
+	/*
+	 * pushed sends complete on return, i.e. the sender 
+	 * may already have notified the next send. Senders only
+	 * push if we have announced (push enabled on our side).
+	 */
+	ASSERT(rval == recv_count + 1
+	       || (neighborhood_id->type_element[type_id].push 
+		   && rval == recv_count + 2));
+	id = idx;
+    }
+    else
+    {
+	shan_mailbox_clear(neighborhood_id
+			   , type_id
+			   , idx
+			   , SHAN_MAILBOX_RECV
+	    );
+    }
+  
+    return (id == -1) ? -1 : SHAN_SUCCESS;
+}
+
+
+/*
+ * marks all types of a coalesced write as received,
+ * following the chain of headers from the lead type.
+ * Coalesced writes led by the same type are chained backwards,
+ * the notification value is the stage of the last one.
+ */
+static void shan_comm_batch_walk(shan_neighborhood_t *const neighborhood_id
+				 , int const lead_id
+				 , int const idx
+				 , int const count
+    )
+{
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+    shan_element_t *const lead_element = &(neighborhood_id->type_element[lead_id]);
+    int const seen = lead_element->batch_seen[idx];
+
+    int lead_count = count;
+    while (lead_count > seen)
+    {
+	int type_id = lead_id;
+	int type_count = lead_count;
+	int *comm_header = NULL, *lead_header = NULL;
+	do
+	{
+	    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+	    int const sid = (type_count - 1) % type_element->num_buffer;
+	    comm_header = (int *) ((char*) remote_segment->shan_ptr 
+				   + type_element->handle[idx].recv_buffer[sid]);
+	    ASSERT(*(comm_header + 2) == type_count);
+	    ASSERT(*(comm_header + 4) == 1);
+
+	    type_element->batch_ready[idx * type_element->num_buffer + sid] = type_count;
+	    lead_header = (lead_header == NULL) ? comm_header : lead_header;
+
+	    type_id    = *(comm_header + 5) - 1;
+	    type_count = *(comm_header + 6);
+	} 
+	while (type_id != -1);
+
+	lead_count = *(lead_header + 7);
+    }
+    lead_element->batch_seen[idx] = MAX(seen, count);
+}
+
+
+/*
+ * processes arrived coalesced writes from a neighbor,
+ * one GASPI call for all lead types.
+ */
+static void shan_comm_batch_progress(shan_neighborhood_t *const neighborhood_id
+				     , int const idx
+    )
+{
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type      = neighborhood_id->num_type;
+    int const first_nid 
+	= GET_BATCH_NOTIFICATION_ID(neighborhood_id->num_buffer_max, num_type, 0, num_neighbors, idx);
+
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+    int start = 0;
+    while (start < num_type)
+    {
+	gaspi_notification_id_t nid;
+	gaspi_return_t ret;
+	if ((ret = gaspi_notify_waitsome (remote_segment->shan_id
+					  , (gaspi_notification_id_t) (first_nid + start)
+					  , (gaspi_number_t) (num_type - start)
+					  , &nid
+					  , GASPI_TEST
+		 )) != GASPI_SUCCESS)
+	{
+	    ASSERT (ret != GASPI_ERROR);
+	    break;
+	}
+
+	int const lead_id = (int) nid - first_nid;
+	while (__sync_lock_test_and_set(&(neighborhood_id->batch_lock), 1))
+	{
+	    _mm_pause();
+	}
+	gaspi_notification_t nval;
+	SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
+					   , nid
+					   , &nval
+			   )); 
+	if (nval != 0)
+	{
+	    shan_comm_batch_walk(neighborhood_id
+				 , lead_id
+				 , idx
+				 , (int) nval
+		);
+	}
+	__sync_lock_release(&(neighborhood_id->batch_lock));
+
+	start = lead_id + 1;
+    }
+}
+
+
+/*
+ * pull mode: read the next message from the send buffer of the 
+ * neighbor once it is flagged as ready, then test for the read.
+ */
+static int shan_comm_test_pull(shan_neighborhood_t *const neighborhood_id
+			       , int const type_id
+			       , int const idx
+			       , int const notified
+    )
+{
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type      = neighborhood_id->num_type;
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    shan_handle_t const *const handle = &(type_element->handle[idx]);
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+
+    int const recv_count = type_element->local_recv_count[idx];
+    int const sid = recv_count % type_element->num_buffer;  
+    int const rank = neighborhood_id->neighbors[idx];
+    int const read_nid 
+	= GET_PULL_NOTIFICATION_ID(neighborhood_id->num_buffer_max, num_type, type_id, num_neighbors, idx);
+
+    gaspi_notification_id_t tmp_id;
+    gaspi_notification_t nval;
+    gaspi_return_t ret;
+    if (type_element->pull_count[idx] != recv_count + 1)
+    {
+	int const nid = GET_NOTIFICATION_ID(sid, num_type, type_id, num_neighbors, idx);
+	if (!notified
+	    && ( ret =
+		 gaspi_notify_waitsome (remote_segment->shan_id
+					, nid
+					, 1
+					, &tmp_id
+					, GASPI_TEST
+		     )
+		) != GASPI_SUCCESS)
+	{
+	    ASSERT (ret != GASPI_ERROR);
+	    return 0;
+	}
+	SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
+					   , (gaspi_notification_id_t) nid
+					   , &nval
+			   )); 
+	ASSERT(rank == (int) nval - 1);
+
+#ifdef USE_VARIABLE_MESSAGE_LEN
+	long const size = handle->recv_sz;
+#else
+	type_local_t const *const type_info = &(type_element->local_type);
+	long const size = NELEM_COMM_HEADER * sizeof(int)
+	    + (long) type_info->nelem_recv[idx] * type_info->recv_sz[idx];
+	ASSERT(size <= handle->recv_sz);
+#endif
+
+	gaspi_queue_id_t queue = shan_comm_queue(neighborhood_id, type_id, idx);
+	shan_comm_queue_reserve(neighborhood_id, &queue, 2);
+	read_notify_and_wait ( remote_segment->shan_id
+			       , handle->recv_buffer[sid]
+			       , rank
+			       , handle->remote_send_buffer[sid]
+			       , (gaspi_size_t) size
+			       , (gaspi_notification_id_t) read_nid
+			       , queue
+	    );
+	type_element->pull_count[idx] = recv_count + 1;
+    }
+
+    if (( ret =
+	  gaspi_notify_waitsome (remote_segment->shan_id
+				 , read_nid
+				 , 1
+				 , &tmp_id
+				 , GASPI_TEST
+	      )
+	    ) != GASPI_SUCCESS)
+    {
+	ASSERT (ret != GASPI_ERROR);
+	return 0;
+    }
+    SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
+				       , tmp_id
+				       , &nval
+		       )); 
+
+    return 1;
+}
+
+
+int shan_comm_waitsome_remote(shan_neighborhood_t *const neighborhood_id
+			      , int const type_id
+			      , int const idx
+			      , int const notified
+    )
+{
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type      = neighborhood_id->num_type;
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+
+    int const recv_count = type_element->local_recv_count[idx];
+    int const sid = recv_count % type_element->num_buffer;  
+    int const ready = idx * type_element->num_buffer + sid;
+    int const nid = GET_NOTIFICATION_ID(sid, num_type, type_id, num_neighbors, idx);
+    int const rank = neighborhood_id->neighbors[idx];
+  
+    /*
+     * arrived either with its own notification 
+     * or as part of a coalesced write
+     */
+    int arrived = (type_element->batch_ready[ready] == recv_count + 1);
+    if (!arrived && type_element->pull)
+    {
+	arrived = shan_comm_test_pull(neighborhood_id
+				      , type_id
+				      , idx
+				      , notified
+	    );
+    }
+    else if (!arrived)
+    {
+	/*
+	 * a notification found by a range scan is only reset
+	 */
+	shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+	gaspi_notification_id_t tmp_id;
+	gaspi_notification_t nval;
+	gaspi_return_t ret;
+	if (notified
+	    || ( ret =
+		 gaspi_notify_waitsome (remote_segment->shan_id
+					, nid
+					, 1
+					, &tmp_id
+					, GASPI_TEST
+		     )
+		) == GASPI_SUCCESS)
+	{
+	    SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
+					       , (gaspi_notification_id_t) nid
+					       , &nval
+			       )); 
+	    int const remote_rank = nval - 1;
+	    ASSERT(rank == remote_rank);
+	    arrived = 1;
+	}
+	else
+	{
+	    ASSERT (ret != GASPI_ERROR);
+	}
+    }
+
+    if (!arrived && neighborhood_id->coalesce)
+    {
+	shan_comm_batch_progress(neighborhood_id
+				 , idx
+	    );
+	arrived = (type_element->batch_ready[ready] == recv_count + 1);
+    }
+
+    if (!arrived)
+    {
+	return -1;
+    }
+
+    type_local_t *const type_info = &(type_element->local_type);
+    void *comm_ptr = (char*) neighborhood_id->remote_segment.shan_ptr 
+	+ type_element->handle[idx].recv_buffer[sid];
+    int *const comm_header = (int *) comm_ptr;
+    int const nelem_send   = *(comm_header);
+    int const send_sz      = *(comm_header + 1);
+    int const rval         = *(comm_header + 2);	
+
+    /*
+     * pull mode is rank local, both sides have to agree per type
+     */
+    ASSERT(*(comm_header + 8) == type_element->pull);
+    ASSERT(rval > recv_count);
+    ASSERT(recv_count <= rval + 2);
+
+#ifdef USE_VARIABLE_MESSAGE_LEN
+    type_info->nelem_recv[idx] = nelem_send;
+    type_info->recv_sz[idx]    = send_sz;
+#else
+    ASSERT(type_info->nelem_recv[idx] == nelem_send);
+    ASSERT(type_info->recv_sz[idx] == send_sz);
+#endif
+
+    return SHAN_SUCCESS;
+}
+
+
+
+
+
+/*
+ * contiguous send data in a GASPI registered data segment 
+ * can be written without staging copy.
+ */
+static int shan_comm_send_contiguous(shan_segment_t const *const data_segment
+				     , shan_copy_desc_t const *const send_desc
+				     , shan_copy_plan_t const *const plan
+				     , int const nelem_send
+				     , int const send_sz
+				     , long *data_offset
+    )
+{
+    if (data_segment->gaspi_id < 0 || nelem_send <= 0 || send_sz <= 0)
+    {
+	return 0;
+    }
+
+    if (nelem_send == 1)
+    {
+	*data_offset = (send_desc->block != NULL) 
+	    ? send_desc->block[0].base : send_desc->offset[0];
+	return 1;
+    }
+
+    if (shan_copy_plan_valid(plan, nelem_send, send_sz)
+	&& plan->nblock == 1
+	&& plan->block[0].src_stride == send_sz)
+    {
+	*data_offset = plan->block[0].src;
+	return 1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * contiguous receive data in a GASPI registered data segment
+ * can be placed directly by the sender.
+ */
+static int shan_comm_recv_contiguous(shan_segment_t const *const data_segment
+				     , shan_copy_desc_t const *const recv_desc
+				     , shan_copy_plan_t const *const plan
+				     , int const nelem_recv
+				     , int const recv_sz
+				     , long *data_offset
+    )
+{
+    if (data_segment->gaspi_id < 0 || nelem_recv <= 0 || recv_sz <= 0)
+    {
+	return 0;
+    }
+
+    if (nelem_recv == 1)
+    {
+	*data_offset = (recv_desc->block != NULL) 
+	    ? recv_desc->block[0].base : recv_desc->offset[0];
+	return 1;
+    }
+
+    if (shan_copy_plan_valid(plan, nelem_recv, recv_sz)
+	&& plan->nblock == 1
+	&& plan->block[0].dest_stride == recv_sz)
+    {
+	*data_offset = plan->block[0].dest;
+	return 1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * offset of a direct receive descriptor slot in the remote segment
+ * (slot 0: incoming, slot 1,2: outgoing, double buffered),
+ * in front of the send / recv buffers
+ */
+static long shan_direct_offset(int const num_neighbors
+			       , int const type_id
+			       , int const idx
+			       , int const slot
+    )
+{
+    return (NUM_DIRECT_SLOT * (type_id * num_neighbors + idx) + slot) 
+	* (long) sizeof(shan_direct_t);
+}
+
+
+/*
+ * announce the next receive from a remote neighbor as directly placeable
+ * (direct types only, see shan_comm_set_direct).
+ * A receiver calls this with its own send, i.e. after it is done 
+ * with the previous receive.
+ */
+static void shan_comm_post_direct(shan_neighborhood_t *const neighborhood_id
+				  , shan_segment_t *const data_segment
+				  , type_local_t const *const type_info
+				  , int const type_id
+				  , int const idx
+    )
+{
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type      = neighborhood_id->num_type;
+    int const rank          = neighborhood_id->neighbors[idx];
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    int const count         = type_element->local_recv_count[idx] + 1;
+
+    if (!type_element->direct
+	|| neighborhood_id->direct_segment[idx] != data_segment->gaspi_id
+	|| type_element->direct_count[idx] == count)
+    {
+	return;
+    }
+
+    int const nelem_recv = type_info->nelem_recv[idx];
+    int const recv_sz    = type_info->recv_sz[idx];
+    shan_copy_desc_t recv_desc;
+    shan_copy_desc_recv(&recv_desc
+			, type_info
+			, type_element
+			, idx
+	);
+
+    long data_offset = 0;
+    if (!shan_comm_recv_contiguous(data_segment
+				   , &recv_desc
+				   , &(type_element->recv_plan[idx])
+				   , nelem_recv
+				   , recv_sz
+				   , &data_offset
+	    ))
+    {
+	return;
+    }
+
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+    long const offset_local = shan_direct_offset(num_neighbors
+						 , type_id
+						 , idx
+						 , 1 + count % 2
+	);
+
+    shan_direct_t *const direct 
+	= (shan_direct_t *) ((char*) remote_segment->shan_ptr + offset_local);
+    direct->offset   = data_offset;
+    direct->size     = (long) nelem_recv * recv_sz;
+    direct->gaspi_id = data_segment->gaspi_id;
+    direct->count    = count;
+
+    int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
+    int const RemoteNumNeighbors = neighborhood_id->RemoteNumNeighbors[idx];
+    long const offset_remote = shan_direct_offset(RemoteNumNeighbors
+						  , type_id
+						  , RemoteCommIdx
+						  , 0
+	);
+    const gaspi_notification_id_t nid
+	= GET_NOTIFICATION_ID(neighborhood_id->num_buffer_max, num_type, type_id
+			      , RemoteNumNeighbors, RemoteCommIdx);
+
+    /* 
+     * single notified write, needs no ordering with the data
+     */
+    gaspi_queue_id_t queue = shan_comm_queue(neighborhood_id, type_id, idx);
+    shan_comm_queue_reserve(neighborhood_id, &queue, 2);
+
+    write_notify_and_wait ( remote_segment->shan_id
+			    , offset_local
+			    , rank
+			    , offset_remote
+			    , (gaspi_size_t) sizeof(shan_direct_t)
+			    , nid
+			    , (gaspi_notification_t) count
+			    , queue
+	);
+
+    type_element->direct_count[idx] = count;
+}
+
+
+/*
+ * test for a receive descriptor matching the next send
+ */
+static int shan_comm_test_direct(shan_neighborhood_t *const neighborhood_id
+				 , int const type_id
+				 , int const idx
+				 , long const data_size
+				 , shan_direct_t *const direct
+    )
+{
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type      = neighborhood_id->num_type;
+    int const count 
+	= neighborhood_id->type_element[type_id].local_send_count[idx] + 1;
+    int const nid 
+	= GET_NOTIFICATION_ID(neighborhood_id->num_buffer_max, num_type, type_id, num_neighbors, idx);
+
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+    gaspi_notification_id_t tmp_id;
+    gaspi_notification_t nval;
+    gaspi_return_t ret;
+    if (( ret =
+	  gaspi_notify_waitsome (remote_segment->shan_id
+				 , nid
+				 , 1
+				 , &tmp_id
+				 , GASPI_TEST
+	      )
+	    ) != GASPI_SUCCESS)
+    {
+	ASSERT (ret != GASPI_ERROR);
+	return 0;
+    }
+
+    SUCCESS_OR_DIE(gaspi_notify_reset (remote_segment->shan_id
+				       , tmp_id
+				       , &nval
+		       )); 
+    if ((int) nval != count)
+    {
+	return 0;
+    }
+
+    long const offset = shan_direct_offset(num_neighbors
+					   , type_id
+					   , idx
+					   , 0
+	);
+    *direct = *((shan_direct_t *) ((char*) remote_segment->shan_ptr + offset));
+    ASSERT(direct->count == count);
+
+    return (direct->size == data_size) ? 1 : 0;
+}
+
+
+/*
+ * packs a remote message (or prepares zero copy/direct placement)
+ * and appends its writes to the write list: payload if written 
+ * separately, then header (+ payload). Returns the message header.
+ */
+static int *shan_comm_stage_remote(shan_neighborhood_t *const neighborhood_id
+				   , shan_segment_t *const data_segment
+				   , int const type_id
+				   , int const idx
+				   , gaspi_queue_id_t const queue
+				   , shan_write_list_t *const list
+    )
+{
+    int const iProcLocal = neighborhood_id->iProcLocal;
+    int const sid  
+	= (neighborhood_id->type_element[type_id].local_send_count[idx])
+	% neighborhood_id->type_element[type_id].num_buffer;	    
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    shan_handle_t const *const handle = &(type_element->handle[idx]);
+    type_local_t const *const type_info = &(type_element->local_type);
+      
+    int nelem_send     = type_info->nelem_send[idx];
+    int send_sz        = type_info->send_sz[idx];
+    shan_copy_desc_t send_desc, linear;
+    shan_copy_desc_send(&send_desc
+			, type_info
+			, type_element
+			, idx
+	);
+    shan_copy_desc_linear(&linear);
+      
+    void *data_ptr;
+    shan_get_shared_ptr(data_segment
+			, iProcLocal
+			, &data_ptr);
+
+    long const offset_local  = handle->send_buffer[sid];
+    long const offset_remote = handle->remote_recv_buffer[sid];
+      
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+    void *comm_ptr = (char*) remote_segment->shan_ptr + offset_local;
+	
+    int const pull = type_element->pull;
+
+    long const header_size = NELEM_COMM_HEADER * sizeof(int);
+    long const data_size   = (long) nelem_send * send_sz;
+    ASSERT(header_size + data_size <= handle->send_sz);
+
+    shan_direct_t direct;
+    int const direct_mode = !pull && shan_comm_test_direct(neighborhood_id
+							   , type_id
+							   , idx
+							   , data_size
+							   , &direct
+	);
+
+    long data_offset = 0;
+    int const zero_copy = !pull && shan_comm_send_contiguous(data_segment
+							     , &send_desc
+							     , &(type_element->send_plan[idx])
+							     , nelem_send
+							     , send_sz
+							     , &data_offset
+	);
+
+    if (!zero_copy)
+    {
+	void *const send_buf = (char*) comm_ptr + header_size;
+	shan_copy_plan_t *const plan = &(type_element->send_plan[idx]);
+	if (shan_copy_plan_valid(plan, nelem_send, send_sz))
+	{
+	    shan_copy_plan_execute(plan, send_buf, data_ptr, type_element->stream_threshold);
+	}
+	else
+	{
+	    shan_copy_elements(send_buf
+			       , &linear
+			       , data_ptr
+			       , &send_desc
+			       , nelem_send
+			       , send_sz
+			       , type_element->stream_threshold
+		);
+	}
+    }
 	  
-	int *const comm_header = (int *) ((char*) comm_ptr);
-	*(comm_header)      = nelem_send;
-	*(comm_header + 1)  = send_sz;
-	*(comm_header + 2)  = neighborhood_id->type_element[type_id].local_send_count[idx] + 1;
-
-	long const comm_size = nelem_send * send_sz + NELEM_COMM_HEADER * sizeof(int);		
-	write_notify_and_wait ( remote_segment->shan_id
-				, offset_local
+    int *const comm_header = (int *) ((char*) comm_ptr);
+    *(comm_header)      = nelem_send;
+    *(comm_header + 1)  = send_sz;
+    *(comm_header + 2)  = type_element->local_send_count[idx] + 1;
+    *(comm_header + 3)  = direct_mode;
+    *(comm_header + 4)  = 0;
+    *(comm_header + 5)  = 0;
+    *(comm_header + 6)  = 0;
+    *(comm_header + 7)  = 0;
+    *(comm_header + 8)  = pull;
+    *(comm_header + 9)  = 0;
+
+    if (zero_copy || direct_mode)
+    {
+	/*
+	 * payload as separate write, either straight from the registered 
+	 * data segment or directly into receiver data (or both).
+	 * The notified header write is ordered behind it (same queue).
+	 */
+	int const k = list->num++;
+	list->segment_local[k]  = zero_copy ? data_segment->gaspi_id : remote_segment->shan_id;
+	list->offset_local[k]   = zero_copy ? data_offset : offset_local + header_size;
+	list->segment_remote[k] = direct_mode ? direct.gaspi_id : remote_segment->shan_id;
+	list->offset_remote[k]  = direct_mode ? direct.offset : offset_remote + header_size;
+	list->size[k]           = (gaspi_size_t) data_size;
+    }
+    type_element->zero_copy_pending[idx] = zero_copy ? (int) queue + 1 : 0;
+
+    int const k = list->num++;
+    list->segment_local[k]  = remote_segment->shan_id;
+    list->offset_local[k]   = offset_local;
+    list->segment_remote[k] = remote_segment->shan_id;
+    list->offset_remote[k]  = offset_remote;
+    list->size[k]           = (zero_copy || direct_mode) ? header_size : data_size + header_size;
+
+    return comm_header;
+}
+
+
+int shan_comm_notify_or_write(shan_neighborhood_t *const neighborhood_id
+			      , shan_segment_t *const data_segment
+			      , int type_id
+			      , int idx
+    )
+
+{
+    int const num_neighbors = neighborhood_id->num_neighbors;
+
+    ASSERT(idx >= 0);
+    ASSERT(idx < num_neighbors);
+  
+    int const rank = neighborhood_id->neighbors[idx];
+    int const sid  
+	= (neighborhood_id->type_element[type_id].local_send_count[idx])
+	% neighborhood_id->type_element[type_id].num_buffer;	    
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+    shan_handle_t const *const handle = &(type_element->handle[idx]);
+
+    SHAN_STATS_ADD(neighborhood_id, type_id, idx, num_send, 1);
+    SHAN_STATS_ADD(neighborhood_id, type_id, idx, bytes_send
+		   , (long) type_element->local_type.nelem_send[idx] 
+		   * type_element->local_type.send_sz[idx]);
+	
+    if (handle->local_rank != -1)
+    {
+	/*
+	 * push mode: we are done with the last receive from idx, 
+	 * then push if idx is done with its last receive from us
+	 */
+	shan_comm_recv_ready(neighborhood_id
+			     , type_id
+			     , idx
+	    );
+	shan_comm_put_local(neighborhood_id
+			    , data_segment
+			    , type_id
+			    , idx
+	    );
+
+	shan_increment_local(neighborhood_id
+			     , type_id
+			     , idx
+	    );      
+
+	++(neighborhood_id->type_element[type_id].local_send_count[idx]);
+    }
+    else
+    {
+	shan_write_list_t list;
+	list.num = 0;
+
+	/*
+	 * receive side, announce direct placement for our next receive,
+	 * before the reservation (own queue requests).
+	 * Pulled messages are read from the send buffer as a whole.
+	 */
+	if (!type_element->pull)
+	{
+	    shan_comm_post_direct(neighborhood_id
+				  , data_segment
+				  , &(type_element->local_type)
+				  , type_id
+				  , idx
+		);
+	}
+
+	/*
+	 * payload + header + notification, or the pull notification
+	 */
+	gaspi_queue_id_t queue = shan_comm_queue(neighborhood_id, type_id, idx);
+	if (shan_comm_queue_reserve(neighborhood_id
+				    , &queue
+				    , type_element->pull ? 1 : 3
+		))
+	{
+	    SHAN_STATS_ADD(neighborhood_id, type_id, idx, queue_full, 1);
+	}
+	shan_comm_stage_remote(neighborhood_id
+			       , data_segment
+			       , type_id
+			       , idx
+			       , queue
+			       , &list
+	    );
+	if (type_element->pull)
+	{
+	    /*
+	     * flag the send buffer as ready, the receiver reads it
+	     */
+	    SUCCESS_OR_DIE(gaspi_notify (neighborhood_id->remote_segment.shan_id
+					 , rank
+					 , (gaspi_notification_id_t) handle->notify_id[sid]
+					 , (gaspi_notification_t) neighborhood_id->iProcGlobal + 1
+					 , queue
+					 , GASPI_BLOCK
+			       ));
+	    ++(neighborhood_id->type_element[type_id].local_send_count[idx]);
+	    return SHAN_SUCCESS;
+	}
+
+	if (list.num > 1)
+	{
+	    write_and_wait ( list.segment_local[0]
+			     , list.offset_local[0]
+			     , rank
+			     , list.segment_remote[0]
+			     , list.offset_remote[0]
+			     , list.size[0]
+			     , queue
+		);
+	}
+
+	int const k = list.num - 1;
+	write_notify_and_wait ( list.segment_local[k]
+				, list.offset_local[k]
 				, rank
-				, offset_remote
-				, (gaspi_size_t) comm_size
-				, (gaspi_notification_id_t) nid
+				, list.offset_remote[k]
+				, list.size[k]
+				, (gaspi_notification_id_t) handle->notify_id[sid]
 				, (gaspi_notification_t) neighborhood_id->iProcGlobal + 1
-				, 0
+				, queue
 	    );
 
 	++(neighborhood_id->type_element[type_id].local_send_count[idx]);
@@ -892,3 +2710,150 @@ int shan_comm_notify_or_write(shan_neighborhood_t *const neighborhood_id
 
 }
 
+
+int shan_comm_notify_or_write_multi(shan_neighborhood_t *const neighborhood_id
+				    , shan_segment_t *const data_segment
+				    , int const *type_ids
+				    , int num_type_ids
+				    , int idx
+    )
+
+{
+    int i;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+
+    ASSERT(idx >= 0);
+    ASSERT(idx < num_neighbors);
+    ASSERT(num_type_ids > 0);
+  
+    int const lead_id = type_ids[0];
+    shan_element_t *const lead_element = &(neighborhood_id->type_element[lead_id]);
+    shan_handle_t const *const handle = &(lead_element->handle[idx]);
+
+    if (handle->local_rank != -1)
+    {
+	/*
+	 * node local, flags only
+	 */
+	for (i = 0; i < num_type_ids; ++i)
+	{
+	    shan_comm_notify_or_write(neighborhood_id
+				      , data_segment
+				      , type_ids[i]
+				      , idx
+		);
+	}
+	return SHAN_SUCCESS;
+    }
+
+    ASSERT(neighborhood_id->coalesce);
+    ASSERT(neighborhood_id->write_list_max >= 2);
+
+    int const rank = neighborhood_id->neighbors[idx];
+    int const lead_count = lead_element->local_send_count[idx] + 1;
+    shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
+
+    /*
+     * receive side, announce direct placement for our next receives,
+     * before the reservation (own queue requests)
+     */
+    for (i = 0; i < num_type_ids; ++i)
+    {
+	shan_element_t *const type_element = &(neighborhood_id->type_element[type_ids[i]]);
+	shan_comm_post_direct(neighborhood_id
+			      , data_segment
+			      , &(type_element->local_type)
+			      , type_ids[i]
+			      , idx
+	    );
+    }
+
+    /*
+     * all write lists and the notification go to one queue (ordering),
+     * reserved up front: at most two writes per type + notification
+     */
+    gaspi_queue_id_t queue = shan_comm_queue(neighborhood_id, lead_id, idx);
+    if (shan_comm_queue_reserve(neighborhood_id
+				, &queue
+				, 2 * num_type_ids + 1
+	    ))
+    {
+	SHAN_STATS_ADD(neighborhood_id, lead_id, idx, queue_full, 1);
+    }
+
+    /*
+     * headers are chained from the lead type, 
+     * the receiver follows the chain on the lead notification.
+     * Every type is written into its own receive buffer ring 
+     * (one list entry each), the receiver unpacks in place.
+     */
+    shan_write_list_t list;
+    list.num = 0;
+    for (i = 0; i < num_type_ids; ++i)
+    {
+	if (list.num + 2 > neighborhood_id->write_list_max)
+	{
+	    write_list_and_wait ( (gaspi_number_t) list.num
+				  , list.segment_local
+				  , list.offset_local
+				  , rank
+				  , list.segment_remote
+				  , list.offset_remote
+				  , list.size
+				  , queue
+		);
+	    list.num = 0;
+	}
+
+	ASSERT(!neighborhood_id->type_element[type_ids[i]].pull);
+	int *const comm_header = shan_comm_stage_remote(neighborhood_id
+							, data_segment
+							, type_ids[i]
+							, idx
+							, queue
+							, &list
+	    );
+	*(comm_header + 4) = 1;
+	if (i + 1 < num_type_ids)
+	{
+	    int const next_id = type_ids[i + 1];
+	    ASSERT(next_id != lead_id);
+	    *(comm_header + 5) = next_id + 1;
+	    *(comm_header + 6) = neighborhood_id->type_element[next_id].local_send_count[idx] + 1;
+	}
+	if (i == 0)
+	{
+	    *(comm_header + 7) = lead_element->batch_prev[idx];
+	}
+    }
+
+    write_list_notify_and_wait ( (gaspi_number_t) list.num
+				 , list.segment_local
+				 , list.offset_local
+				 , rank
+				 , list.segment_remote
+				 , list.offset_remote
+				 , list.size
+				 , remote_segment->shan_id
+				 , (gaspi_notification_id_t) handle->batch_notify_id
+				 , (gaspi_notification_t) lead_count
+				 , queue
+	);
+    lead_element->batch_prev[idx] = lead_count;
+
+    for (i = 0; i < num_type_ids; ++i)
+    {
+#ifdef USE_SHAN_STATS
+	type_local_t const *const type_info 
+	    = &(neighborhood_id->type_element[type_ids[i]].local_type);
+	SHAN_STATS_ADD(neighborhood_id, type_ids[i], idx, num_send, 1);
+	SHAN_STATS_ADD(neighborhood_id, type_ids[i], idx, bytes_send
+		       , (long) type_info->nelem_send[idx] * type_info->send_sz[idx]);
+#endif
+	++(neighborhood_id->type_element[type_ids[i]].local_send_count[idx]);
+    }
+
+    return SHAN_SUCCESS;
+
+}
+
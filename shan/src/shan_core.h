@@ -25,20 +25,153 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "GASPI.h"
 #include "SHAN_segment.h"
 
 
-#define NELEM_COMM_HEADER 3
+/* default spin iterations and block timeout of wait policies */
+#define SHAN_WAIT_SPIN_COUNT 4096
+#define SHAN_WAIT_TIMEOUT_US 100
+
+/* 
+ * nelem, elem size, count, direct placement flag, 
+ * coalesced write: flag, next type + 1, next count, previous lead count,
+ * pull mode flag of sender, padding (long alignment of payload)
+ */
+#define NELEM_COMM_HEADER 10
 #define ALIGNMENT 64
 
+/* direct receive slots per type and neighbor: incoming + 2 outgoing */
+#define NUM_DIRECT_SLOT 3
+
+/* default depth of the remote buffer ring per type */
+#define SHAN_NUM_BUFFER 2
+
+/* 
+ * remote notification ids, contiguous in neighbors for given sid and type
+ * (sid 0 .. num_buffer_max-1: data buffer ring, 
+ *  sid num_buffer_max: direct receive descriptor) 
+ */
+#define GET_NOTIFICATION_ID(sid, num_type, type_id, num_neighbors, idx) \
+  ((sid) * ((num_type) * (num_neighbors)) + (type_id) * (num_neighbors) + (idx))  
+
+/* 
+ * remote notification ids of coalesced writes, behind the above, 
+ * contiguous in lead types for given neighbor
+ */
+#define GET_BATCH_NOTIFICATION_ID(num_buffer_max, num_type, type_id, num_neighbors, idx) \
+  (((num_buffer_max) + 1) * ((num_type) * (num_neighbors)) + (idx) * (num_type) + (type_id))
+
+/* 
+ * remote notification ids of signals, behind the coalesced writes,
+ * one per neighbor
+ */
+#define GET_SIGNAL_NOTIFICATION_ID(num_buffer_max, num_type, num_neighbors, idx) \
+  (((num_buffer_max) + 2) * ((num_type) * (num_neighbors)) + (idx))
+
+/* 
+ * remote notification ids of pulled reads (pull mode), behind the signals,
+ * contiguous in neighbors for given type
+ */
+#define GET_PULL_NOTIFICATION_ID(num_buffer_max, num_type, type_id, num_neighbors, idx) \
+  (((num_buffer_max) + 2) * ((num_type) * (num_neighbors)) + (num_neighbors) \
+   + (type_id) * (num_neighbors) + (idx))
+
+/* number of remote notification ids in use */
+#define NUM_NOTIFICATION(num_buffer_max, num_type, num_neighbors) \
+  (((num_buffer_max) + 3) * ((num_type) * (num_neighbors)) + (num_neighbors))
+
+/* 
+ * communication statistics (shan_stats_t), compiled out 
+ * without USE_SHAN_STATS
+ */
+#ifdef USE_SHAN_STATS
+#define SHAN_STATS_ADD(neighborhood_id, type_id, idx, field, val)	\
+  ((neighborhood_id)->type_element[type_id].stats[idx].field += (val))
+#define SHAN_STATS_TIME(t) double const t = MPI_Wtime()
+#else
+#define SHAN_STATS_ADD(neighborhood_id, type_id, idx, field, val)
+#define SHAN_STATS_TIME(t)
+#endif
+
+/* upper bound of GASPI write list entries per coalesced write */
+#define SHAN_WRITE_LIST_MAX 64
+
+/* int meta data arrays per neighbor in shared type, even for long alignment */
+#define NELEM_TYPE_INT 10
+
+#define OFFSET_DESC_SZ(format) \
+  ((format) == SHAN_OFFSET_BLOCK ? sizeof(shan_offset_block_t) : sizeof(long))
+
+/* shared type size per neighbor: notifications, int meta data, offset lists */
+#define TYPE_ELEM_SZ(max_nelem_send, max_nelem_recv, format)		\
+  ((long) (MAX_SHARED_NOTIFICATION * sizeof(shan_notification_t)	\
+	   + NELEM_TYPE_INT * sizeof(int)				\
+	   + ((max_nelem_send) + (max_nelem_recv)) * OFFSET_DESC_SZ(format)))
+
+/* 
+ * shared sync notifications of a rank, in front of the mailboxes:
+ * barrier count and generation (used in local rank 0 only), 
+ * followed by one signal counter per own neighbor index
+ */
+#define SHAN_SYNC_BARRIER_COUNT 0
+#define SHAN_SYNC_BARRIER_GEN   1
+#define SHAN_SYNC_SIGNAL        2
+#define SYNC_SZ(num_neighbors)						\
+  ((long) ((SHAN_SYNC_SIGNAL + (num_neighbors)) * sizeof(shan_notification_t)))
+
+/* 
+ * shared mailbox of a rank per type, in front of the shared types:
+ * one bit per own neighbor index, 'have written' words followed by 
+ * 'have read' words, padded to full cache lines
+ */
+#define SHAN_CACHE_LINE 64
+#define MAILBOX_NWORD(num_neighbors) (((num_neighbors) + 63) / 64)
+#define MAILBOX_SZ(num_neighbors)					\
+  ((long) (((2 * MAILBOX_NWORD(num_neighbors) * sizeof(uint64_t))	\
+	    + SHAN_CACHE_LINE - 1) / SHAN_CACHE_LINE * SHAN_CACHE_LINE))
+
+/* mailbox summary word direction */
+enum shan_mailbox
+{
+    SHAN_MAILBOX_RECV = 0,
+    SHAN_MAILBOX_ACK  = 1
+};
+
+
+/** Receive placement descriptor.
+ *  Published by a receiver with a contiguous receive 
+ *  in a GASPI registered data segment. The sender then 
+ *  writes directly into receiver data, skipping the unpack.
+ */
+typedef struct
+{
+    long offset;                //!< receive offset in data segment (byte)
+    long size;                  //!< receive size (byte)
+    int gaspi_id;               //!< GASPI segment id of data segment
+    int count;                  //!< receive stage counter this descriptor is valid for
+} shan_direct_t;
+
+
+/** GASPI write list, filled per message and posted with a single request.
+ */
+typedef struct
+{
+    int num;                                              //!< number of entries
+    gaspi_segment_id_t segment_local[SHAN_WRITE_LIST_MAX];  //!< local segment ids
+    gaspi_offset_t offset_local[SHAN_WRITE_LIST_MAX];       //!< local offsets
+    gaspi_segment_id_t segment_remote[SHAN_WRITE_LIST_MAX]; //!< remote segment ids
+    gaspi_offset_t offset_remote[SHAN_WRITE_LIST_MAX];      //!< remote offsets
+    gaspi_size_t size[SHAN_WRITE_LIST_MAX];                 //!< sizes (byte)
+} shan_write_list_t;
+
 
 void shan_test_shared(shan_neighborhood_t *const neighborhood_id
-		      , int const rank_local
-		      , int const num_neighbors
 		      , int const type_id
 		      , int const idx
+		      , int const nid
 		      , int *rval
     );
 
@@ -47,14 +180,102 @@ int shan_increment_local(shan_neighborhood_t *const neighborhood_id
 			 , int const idx
     );
 
+/** Tests the own mailbox bit of neighbor idx.
+ *  The shared summary word is only read if the bit is not already
+ *  pending, and taken over into the pending bits if non zero.
+ *  Returns 1 if the neighbor may have notified, 0 otherwise.
+ */
+int shan_mailbox_test(shan_neighborhood_t *const neighborhood_id
+		      , int const type_id
+		      , int const idx
+		      , int const dir
+    );
+
+/** Clears the pending mailbox bit of neighbor idx, 
+ *  after its notification has been found consumed.
+ */
+void shan_mailbox_clear(shan_neighborhood_t *const neighborhood_id
+			, int const type_id
+			, int const idx
+			, int const dir
+    );
+
+/** Takes over all shared summary words of a type and direction.
+ */
+void shan_mailbox_fetch(shan_neighborhood_t *const neighborhood_id
+			, int const type_id
+			, int const dir
+    );
+
+/** GASPI queue for a (type, neighbor) pair. 
+ */
+gaspi_queue_id_t shan_comm_queue(shan_neighborhood_t const *const neighborhood_id
+				 , int const type_id
+				 , int const idx
+    );
+
+/** Makes room for num_req requests in a GASPI queue.
+ *  Completed requests are drained without blocking. If the queue still
+ *  is full, queue is replaced by the next queue of the pool with room.
+ *  A blocking wait only happens if all queues of the pool are full.
+ *  All requests of a message have to be reserved at once, so that
+ *  its notification stays on the queue of its writes.
+ *
+ * @param queue   - in: preferred queue, out: queue to post to
+ * @param num_req - number of requests (capped at the queue size)
+ *
+ * @return 1 if the queue was full, 0 otherwise.
+ */
+int shan_comm_queue_reserve(shan_neighborhood_t *const neighborhood_id
+			     , gaspi_queue_id_t *const queue
+			     , int num_req
+    );
+
+/** Backoff step of a wait loop, according to the wait policy.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param type_id         - type index
+ * @param idx             - comm index waited on, -1 if none
+ * @param send            - 1 for send (ack) waits, 0 for receive waits
+ * @param iter            - wait iteration counter, 0 at loop start
+ */
+void shan_comm_backoff(shan_neighborhood_t *const neighborhood_id
+		       , int const type_id
+		       , int const idx
+		       , int const send
+		       , int *const iter
+    );
+
+/** Backoff step of a wait loop on a shared notification, 
+ *  according to the wait policy. Blocks while ptr[nid] == val.
+ *
+ * @param neighborhood_id - general neighborhood handle
+ * @param ptr             - shared notifications
+ * @param nid             - notification index
+ * @param val             - value waited to change
+ * @param iter            - wait iteration counter, 0 at loop start
+ */
+void shan_comm_backoff_shared(shan_neighborhood_t *const neighborhood_id
+			      , shan_notification_t *const ptr
+			      , int const nid
+			      , int const val
+			      , int *const iter
+    );
+
 int shan_comm_waitsome_local(shan_neighborhood_t *const neighborhood_id
 			     , int const type_id
 			     , int const idx
     );
 
+/** Tests for the next receive from a remote neighbor.
+ *
+ * @param notified - 1 if the notification of the next receive was
+ *                   already found (range scan), it is only reset then
+ */
 int shan_comm_waitsome_remote(shan_neighborhood_t *const neighborhood_id
 			      , int const type_id
 			      , int const idx
+			      , int const notified
     );
 
 #endif
@@ -0,0 +1,644 @@
+/*
+    Copyright (c) T-Systems SfR, C.Simmendinger <christian.simmendinger@t-systems.com>, 2018
+
+    This file is part of SHAN.
+
+    SHAN is free software: you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+	    the Free Software Foundation, either version 3 of the License, or
+	        (at your option) any later version.
+
+    SHAN is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+	    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	        GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+        along with SHAN.  If not, see <https://www.gnu.org/licenses/>.
+	
+*/
+
+
+
+#include <mpi.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <GASPI.h>
+
+#include "SHAN_segment.h"
+#include "SHAN_comm.h"
+#include "SHAN_reduce.h"
+
+#include "gaspi_util.h"
+#include "shan_core.h"
+#include "shan_util.h"
+#include "assert.h"
+
+
+/* 
+ * shared per local rank: arrival and result notification, 
+ * contribution, result (master only) 
+ */
+#define REDUCE_ARRIVE 0
+#define REDUCE_RESULT 1
+#define REDUCE_HEADER_SZ (2 * sizeof(shan_notification_t))
+
+/* 
+ * remote slots of a master: partial result (send source), 
+ * broadcast, one per tree level for the child of that level
+ */
+#define REDUCE_SLOT_PARTIAL 0
+#define REDUCE_SLOT_BCAST   1
+#define REDUCE_SLOT_CHILD(level) (2 + (level))
+
+/* notification ids: broadcast, one per tree level for the child */
+#define REDUCE_NOTIFY_BCAST 0
+#define REDUCE_NOTIFY_CHILD(level) (1 + (level))
+
+/* progress of a reduction */
+enum 
+{
+    SHAN_REDUCE_DONE = 0,
+    SHAN_REDUCE_GATHER,
+    SHAN_REDUCE_UP,
+    SHAN_REDUCE_DOWN_WAIT,
+    SHAN_REDUCE_DOWN,
+    SHAN_REDUCE_RESULT
+};
+
+
+static int shan_reduce_num_level(int const num_master)
+{
+    int num_level = 0;
+    while ((1 << num_level) < num_master)
+    {
+	num_level++;
+    }
+    return num_level;
+}
+
+
+static int shan_reduce_level(int const mask)
+{
+    int level = 0;
+    while ((1 << level) < mask)
+    {
+	level++;
+    }
+    return level;
+}
+
+
+static shan_notification_t *shan_reduce_sync(shan_reduce_t *const reduce_id
+					     , int const local_rank
+    )
+{
+    void *shm_ptr;
+    shan_get_shared_ptr(&(reduce_id->shared_segment)
+			, local_rank
+			, &shm_ptr);
+    return (shan_notification_t *) shm_ptr;
+}
+
+
+static double *shan_reduce_contrib(shan_reduce_t *const reduce_id
+				   , int const local_rank
+    )
+{
+    return (double *) ((char *) shan_reduce_sync(reduce_id, local_rank) 
+		       + REDUCE_HEADER_SZ);
+}
+
+
+static double *shan_reduce_result(shan_reduce_t *const reduce_id
+				  , int const local_rank
+    )
+{
+    return shan_reduce_contrib(reduce_id, local_rank) + reduce_id->max_count;
+}
+
+
+static double *shan_reduce_slot(shan_reduce_t *const reduce_id
+				, int const slot
+    )
+{
+    return (double *) reduce_id->remote_segment.shan_ptr + (long) slot * reduce_id->max_count;
+}
+
+
+static void shan_reduce_combine(double *const dest
+				, double const *const src
+				, int const count
+				, int const op
+    )
+{
+    int i;
+    switch (op)
+    {
+    case SHAN_SUM:
+	for (i = 0; i < count; ++i)
+	{
+	    dest[i] += src[i];
+	}
+	break;
+    case SHAN_MAX:
+	for (i = 0; i < count; ++i)
+	{
+	    dest[i] = MAX(dest[i], src[i]);
+	}
+	break;
+    case SHAN_MIN:
+	for (i = 0; i < count; ++i)
+	{
+	    dest[i] = MIN(dest[i], src[i]);
+	}
+	break;
+    default:
+	ASSERT(0);
+    }
+}
+
+
+static void shan_reduce_register(shan_reduce_t *const reduce_id
+				 , int const master
+    )
+{
+    int const rank = reduce_id->master_rank[master];
+    SUCCESS_OR_DIE(gaspi_connect (rank, GASPI_BLOCK));
+    SUCCESS_OR_DIE(gaspi_segment_register(reduce_id->reduce_id
+					  , rank
+					  , GASPI_BLOCK
+		       ));
+}
+
+
+/*
+ * connect and register the master segment with parent and children
+ */
+static void shan_reduce_connect(shan_reduce_t *const reduce_id
+				, int const num_level
+    )
+{
+    int m;
+    int const iMaster = reduce_id->iMaster;
+    int const low = (iMaster > 0) ? (iMaster & -iMaster) : (1 << num_level);
+    if (iMaster > 0)
+    {
+	shan_reduce_register(reduce_id
+			     , iMaster - low
+	    );
+    }
+    for (m = low >> 1; m > 0; m >>= 1)
+    {
+	if (iMaster + m < reduce_id->num_master)
+	{
+	    shan_reduce_register(reduce_id
+				 , iMaster + m
+		);
+	}
+    }
+}
+
+
+static int shan_reduce_notified(shan_reduce_t *const reduce_id
+				, int const nid
+    )
+{
+    gaspi_notification_id_t tmp_id;
+    gaspi_notification_t nval;
+    gaspi_return_t ret;
+    if ((ret = gaspi_notify_waitsome (reduce_id->reduce_id
+				      , (gaspi_notification_id_t) nid
+				      , 1
+				      , &tmp_id
+				      , GASPI_TEST
+	     )) != GASPI_SUCCESS)
+    {
+	ASSERT (ret != GASPI_ERROR);
+	return 0;
+    }
+
+    SUCCESS_OR_DIE(gaspi_notify_reset (reduce_id->reduce_id
+				       , tmp_id
+				       , &nval
+		       ));
+    ASSERT((int) nval == reduce_id->epoch);
+    return 1;
+}
+
+
+static void shan_reduce_write(shan_reduce_t *const reduce_id
+			      , int const slot_local
+			      , int const master
+			      , int const slot_remote
+			      , int const nid
+    )
+{
+    shan_neighborhood_t *const neighborhood_id = reduce_id->neighborhood;
+    long const slot_sz = reduce_id->max_count * sizeof(double);
+    gaspi_queue_id_t queue = shan_comm_queue(neighborhood_id, 0, 0);
+    shan_comm_queue_reserve(neighborhood_id
+			    , &queue
+			    , 2
+	);
+    write_notify_and_wait ( reduce_id->reduce_id
+			    , (gaspi_offset_t) (slot_local * slot_sz)
+			    , reduce_id->master_rank[master]
+			    , (gaspi_offset_t) (slot_remote * slot_sz)
+			    , reduce_id->count * sizeof(double)
+			    , (gaspi_notification_id_t) nid
+			    , (gaspi_notification_t) reduce_id->epoch
+			    , queue
+	);
+}
+
+
+int shan_comm_init_reduce(shan_reduce_t *const reduce_id
+			  , shan_neighborhood_t *const neighborhood_id
+			  , int segment_id
+			  , int max_count
+    )
+{
+    int i;
+    ASSERT(reduce_id != NULL);
+    ASSERT(neighborhood_id != NULL);
+    ASSERT(max_count > 0);
+
+    reduce_id->neighborhood = neighborhood_id;
+    reduce_id->reduce_id    = segment_id;
+    reduce_id->max_count    = max_count;
+    reduce_id->num_master   = 0;
+    reduce_id->iMaster      = -1;
+    reduce_id->master_rank  = NULL;
+    reduce_id->epoch        = 0;
+    reduce_id->count        = 0;
+    reduce_id->op           = SHAN_SUM;
+    reduce_id->recvbuf      = NULL;
+    reduce_id->state        = SHAN_REDUCE_DONE;
+    reduce_id->mask         = 0;
+
+    reduce_id->remote_segment.shan_id  = segment_id;
+    reduce_id->remote_segment.dataSz   = 0;
+    reduce_id->remote_segment.shan_ptr = NULL;
+
+    /*
+     * node local contributions and result
+     */
+    long const sz = UP(REDUCE_HEADER_SZ + 2 * max_count * sizeof(double), ALIGNMENT);
+    int res = shan_alloc_shared(&(reduce_id->shared_segment)
+				, segment_id
+				, SHAN_TYPE
+				, sz
+				, neighborhood_id->MPI_COMM_SHM
+	);
+    ASSERT(res == SHAN_SUCCESS);
+
+    shan_notification_t *const sync 
+	= shan_reduce_sync(reduce_id, neighborhood_id->iProcLocal);
+    shan_notify_init_shared(sync, REDUCE_ARRIVE);
+    shan_notify_init_shared(sync, REDUCE_RESULT);
+
+    /*
+     * node masters (local rank 0)
+     */
+    MPI_Comm MPI_COMM_MASTER;
+    MPI_Comm_split(neighborhood_id->MPI_COMM_ALL
+		   , neighborhood_id->iProcLocal == 0 ? 0 : MPI_UNDEFINED
+		   , neighborhood_id->iProcGlobal
+		   , &MPI_COMM_MASTER
+	);
+    if (neighborhood_id->iProcLocal == 0)
+    {
+	MPI_Comm_size(MPI_COMM_MASTER, &(reduce_id->num_master));
+	MPI_Comm_rank(MPI_COMM_MASTER, &(reduce_id->iMaster));
+	reduce_id->master_rank = check_malloc(reduce_id->num_master * sizeof(int));
+	MPI_Allgather(&(neighborhood_id->iProcGlobal)
+		      , 1
+		      , MPI_INT
+		      , reduce_id->master_rank
+		      , 1
+		      , MPI_INT
+		      , MPI_COMM_MASTER
+	    );
+
+	int const num_level = shan_reduce_num_level(reduce_id->num_master);
+	int const page_size = sysconf (_SC_PAGESIZE);
+	long const remoteSz 
+	    = UP((REDUCE_SLOT_CHILD(num_level)) * max_count * sizeof(double), page_size);
+	void *rem_ptr = NULL; 
+	res = posix_memalign(&rem_ptr, page_size, remoteSz);
+	ASSERT(res == 0);
+	ASSERT(rem_ptr != NULL);
+	reduce_id->remote_segment.dataSz   = remoteSz;
+	reduce_id->remote_segment.shan_ptr = rem_ptr;
+
+	if (reduce_id->num_master > 1)
+	{
+	    SUCCESS_OR_DIE (gaspi_segment_bind( (gaspi_segment_id_t) segment_id 
+						, rem_ptr
+						, remoteSz
+						, GASPI_PROC_LOCAL
+				));
+	    for (i = 0; i < REDUCE_NOTIFY_CHILD(num_level); ++i)
+	    {
+		gaspi_notification_t nval;
+		SUCCESS_OR_DIE(gaspi_notify_reset (segment_id
+						   , (gaspi_notification_id_t) i
+						   , &nval
+				   ));
+	    }
+	    shan_reduce_connect(reduce_id
+				, num_level
+		);
+
+	    /*
+	     * tree partners are registered and reset
+	     */
+	    MPI_Barrier(MPI_COMM_MASTER);
+	}
+	MPI_Comm_free(&MPI_COMM_MASTER);
+    }
+
+    MPI_Bcast(&(reduce_id->num_master)
+	      , 1
+	      , MPI_INT
+	      , 0
+	      , neighborhood_id->MPI_COMM_SHM
+	);
+
+    /*
+     * shared notifications of all local ranks are reset
+     */
+    MPI_Barrier(neighborhood_id->MPI_COMM_SHM);
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_free_reduce(shan_reduce_t *const reduce_id)
+{
+    ASSERT(reduce_id->state == SHAN_REDUCE_DONE);
+    if (reduce_id->iMaster != -1)
+    {
+	/*
+	 * tree partners only write within a reduction we took part in,
+	 * i.e. no neighbor sync is required
+	 */
+	if (reduce_id->num_master > 1)
+	{
+	    /*
+	     * writes may have spilled to any queue of the pool
+	     */
+	    int i;
+	    for (i = 0; i < reduce_id->neighborhood->num_queue; ++i)
+	    {
+		SUCCESS_OR_DIE (gaspi_wait ((gaspi_queue_id_t) i, GASPI_BLOCK));
+	    }
+	    SUCCESS_OR_DIE(gaspi_segment_delete(reduce_id->reduce_id));
+	}
+	check_free(reduce_id->remote_segment.shan_ptr);
+	check_free(reduce_id->master_rank);
+    }
+    shan_free_shared(&(reduce_id->shared_segment));
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_allreduce_start(shan_reduce_t *const reduce_id
+			      , double const *sendbuf
+			      , double *recvbuf
+			      , int count
+			      , int op
+    )
+{
+    ASSERT(reduce_id->state == SHAN_REDUCE_DONE);
+    ASSERT(count >= 0 && count <= reduce_id->max_count);
+
+    shan_neighborhood_t *const neighborhood_id = reduce_id->neighborhood;
+    reduce_id->epoch++;
+    reduce_id->count   = count;
+    reduce_id->op      = op;
+    reduce_id->recvbuf = recvbuf;
+
+    if (reduce_id->iMaster != -1)
+    {
+	memcpy(shan_reduce_slot(reduce_id, REDUCE_SLOT_PARTIAL)
+	       , sendbuf
+	       , count * sizeof(double));
+	reduce_id->state = SHAN_REDUCE_GATHER;
+    }
+    else
+    {
+	int const iProcLocal = neighborhood_id->iProcLocal;
+	memcpy(shan_reduce_contrib(reduce_id, iProcLocal)
+	       , sendbuf
+	       , count * sizeof(double));
+	shan_notify_increment_shared(shan_reduce_sync(reduce_id, iProcLocal)
+				     , REDUCE_ARRIVE
+				     , 1
+	    );
+	reduce_id->state = SHAN_REDUCE_RESULT;
+    }
+
+    shan_comm_allreduce_test(reduce_id);
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_allreduce_test(shan_reduce_t *const reduce_id)
+{
+    int i;
+    shan_neighborhood_t *const neighborhood_id = reduce_id->neighborhood;
+    int const count = reduce_id->count;
+    int const op    = reduce_id->op;
+    int const epoch = reduce_id->epoch;
+
+    if (reduce_id->state == SHAN_REDUCE_DONE)
+    {
+	return SHAN_SUCCESS;
+    }
+
+    if (reduce_id->state == SHAN_REDUCE_RESULT)
+    {
+	int rval = -1;
+	shan_notify_test_shared(shan_reduce_sync(reduce_id, 0)
+				, REDUCE_RESULT
+				, &rval
+	    );
+	if (rval < epoch)
+	{
+	    return -1;
+	}
+	memcpy(reduce_id->recvbuf
+	       , shan_reduce_result(reduce_id, 0)
+	       , count * sizeof(double));
+	reduce_id->state = SHAN_REDUCE_DONE;
+	return SHAN_SUCCESS;
+    }
+
+    double *const partial = shan_reduce_slot(reduce_id, REDUCE_SLOT_PARTIAL);
+    double *const bcast   = shan_reduce_slot(reduce_id, REDUCE_SLOT_BCAST);
+    if (reduce_id->state == SHAN_REDUCE_GATHER)
+    {
+	/*
+	 * node local contributions, in local rank order
+	 */
+	for (i = 1; i < neighborhood_id->nProcLocal; ++i)
+	{
+	    int rval = -1;
+	    shan_notify_test_shared(shan_reduce_sync(reduce_id, i)
+				    , REDUCE_ARRIVE
+				    , &rval
+		);
+	    if (rval < epoch)
+	    {
+		return -1;
+	    }
+	}
+	for (i = 1; i < neighborhood_id->nProcLocal; ++i)
+	{
+	    shan_reduce_combine(partial
+				, shan_reduce_contrib(reduce_id, i)
+				, count
+				, op
+		);
+	}
+	reduce_id->mask  = 1;
+	reduce_id->state = SHAN_REDUCE_UP;
+    }
+
+    if (reduce_id->state == SHAN_REDUCE_UP)
+    {
+	/*
+	 * binomial tree of masters, combine children, then send to parent
+	 */
+	int const iMaster = reduce_id->iMaster;
+	while (reduce_id->mask < reduce_id->num_master)
+	{
+	    int const mask  = reduce_id->mask;
+	    int const level = shan_reduce_level(mask);
+	    if (iMaster & mask)
+	    {
+		shan_reduce_write(reduce_id
+				  , REDUCE_SLOT_PARTIAL
+				  , iMaster - mask
+				  , REDUCE_SLOT_CHILD(level)
+				  , REDUCE_NOTIFY_CHILD(level)
+		    );
+		reduce_id->state = SHAN_REDUCE_DOWN_WAIT;
+		break;
+	    }
+	    if (iMaster + mask < reduce_id->num_master)
+	    {
+		if (!shan_reduce_notified(reduce_id, REDUCE_NOTIFY_CHILD(level)))
+		{
+		    return -1;
+		}
+		shan_reduce_combine(partial
+				    , shan_reduce_slot(reduce_id, REDUCE_SLOT_CHILD(level))
+				    , count
+				    , op
+		    );
+	    }
+	    reduce_id->mask <<= 1;
+	}
+	if (reduce_id->state == SHAN_REDUCE_UP)
+	{
+	    memcpy(bcast, partial, count * sizeof(double));
+	    reduce_id->state = SHAN_REDUCE_DOWN;
+	}
+    }
+
+    if (reduce_id->state == SHAN_REDUCE_DOWN_WAIT)
+    {
+	if (!shan_reduce_notified(reduce_id, REDUCE_NOTIFY_BCAST))
+	{
+	    return -1;
+	}
+	reduce_id->state = SHAN_REDUCE_DOWN;
+    }
+
+    if (reduce_id->state == SHAN_REDUCE_DOWN)
+    {
+	int m;
+	for (m = reduce_id->mask >> 1; m > 0; m >>= 1)
+	{
+	    if (reduce_id->iMaster + m < reduce_id->num_master)
+	    {
+		shan_reduce_write(reduce_id
+				  , REDUCE_SLOT_BCAST
+				  , reduce_id->iMaster + m
+				  , REDUCE_SLOT_BCAST
+				  , REDUCE_NOTIFY_BCAST
+		    );
+	    }
+	}
+
+	/*
+	 * publish node locally
+	 */
+	memcpy(shan_reduce_result(reduce_id, 0)
+	       , bcast
+	       , count * sizeof(double));
+	memcpy(reduce_id->recvbuf
+	       , bcast
+	       , count * sizeof(double));
+	shan_notify_increment_shared(shan_reduce_sync(reduce_id, 0)
+				     , REDUCE_RESULT
+				     , 1
+	    );
+	reduce_id->state = SHAN_REDUCE_DONE;
+    }
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_allreduce_wait(shan_reduce_t *const reduce_id)
+{
+    int iter = 0;
+    while (shan_comm_allreduce_test(reduce_id) == -1)
+    {
+	if (reduce_id->iMaster == -1)
+	{
+	    shan_comm_backoff_shared(reduce_id->neighborhood
+				     , shan_reduce_sync(reduce_id, 0)
+				     , REDUCE_RESULT
+				     , reduce_id->epoch - 1
+				     , &iter
+		);
+	}
+	else
+	{
+	    shan_comm_backoff(reduce_id->neighborhood
+			      , 0
+			      , -1
+			      , 0
+			      , &iter
+		);
+	}
+    }
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_allreduce(shan_reduce_t *const reduce_id
+			, double const *sendbuf
+			, double *recvbuf
+			, int count
+			, int op
+    )
+{
+    shan_comm_allreduce_start(reduce_id
+			      , sendbuf
+			      , recvbuf
+			      , count
+			      , op
+	);
+    return shan_comm_allreduce_wait(reduce_id);
+}
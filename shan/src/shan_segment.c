@@ -27,10 +27,18 @@
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
+#include <limits.h>
+#include <sched.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 #include <GASPI.h>
 
 #include "SHAN_segment.h"
 #include "shan_util.h"
+#include "gaspi_util.h"
 #include "assert.h"
 
 
@@ -129,6 +137,7 @@ int shan_alloc_shared(shan_segment_t *const segment
 
     segment->shan_id      = shan_id;
     segment->shan_type    = shan_type;
+    segment->gaspi_id     = -1;
 
     segment->ptr_array    = check_malloc (nProcLocal * sizeof(void*));
     segment->localDataSz  = check_malloc (nProcLocal * sizeof(long));
@@ -219,10 +228,41 @@ int shan_get_shared_ptr(shan_segment_t * const segment
     return SHAN_SUCCESS;
 }
 
+int shan_register_shared(shan_segment_t *const segment
+			 , const int gaspi_id
+			 )
+{
+    ASSERT(segment != NULL);
+    ASSERT(segment->gaspi_id == -1);
+    ASSERT(gaspi_id >= 0);
+
+    int iProcLocal;
+    MPI_Comm_rank(segment->MPI_COMM_SHM, &iProcLocal);
+
+    gaspi_number_t segment_max;
+    SUCCESS_OR_DIE (gaspi_segment_max (&segment_max));
+    ASSERT(gaspi_id < (int) segment_max);
+
+    SUCCESS_OR_DIE (gaspi_segment_bind( (gaspi_segment_id_t) gaspi_id
+					, segment->ptr_array[iProcLocal]
+					, (gaspi_size_t) segment->localDataSz[iProcLocal]
+					, GASPI_PROC_LOCAL
+			));
+    segment->gaspi_id = gaspi_id;
+
+    return SHAN_SUCCESS;
+}
+
 int shan_free_shared(shan_segment_t * const segment)
 {
     MPI_Barrier(segment->MPI_COMM_SHM);
 
+    if (segment->gaspi_id >= 0)
+    {
+	SUCCESS_OR_DIE(gaspi_segment_delete((gaspi_segment_id_t) segment->gaspi_id));
+	segment->gaspi_id = -1;
+    }
+
 #ifdef USE_MPI_SHARED_WIN
 
     MPI_Win_free(&segment->segment_win);
@@ -270,6 +310,12 @@ int shan_notify_increment_shared(shan_notification_t *const ptr
   __sync_synchronize();
   volatile int res = __sync_add_and_fetch(&(nid->val),increment);
 
+#ifdef __linux__
+  if (nid->waiters > 0)
+  {
+      syscall(SYS_futex, (int *) &(nid->val), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  }
+#endif
   
   ASSERT(res > 0);
   return SHAN_SUCCESS; 
@@ -292,22 +338,51 @@ int shan_notify_init_shared(shan_notification_t *const ptr
 {
   volatile shan_notification_t *nid = ptr + idx;
   nid->val = 0;
+  nid->waiters = 0;
 
   return SHAN_SUCCESS;
 }
 
 
 
+int shan_notify_wait_shared(shan_notification_t *const ptr
+			    , const int idx
+			    , const int val
+			    , const long timeout_us
+			    )
+{
+  volatile shan_notification_t *nid = ptr + idx;
+
+#ifdef __linux__
+  __sync_add_and_fetch(&(nid->waiters), 1);
+  if (nid->val == val)
+  {
+      struct timespec timeout;
+      timeout.tv_sec  = timeout_us / 1000000;
+      timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+      syscall(SYS_futex, (int *) &(nid->val), FUTEX_WAIT, val, &timeout, NULL, 0);
+  }
+  __sync_sub_and_fetch(&(nid->waiters), 1);
+#else
+  if (nid->val == val)
+  {
+      sched_yield();
+  }
+#endif
+
+  return SHAN_SUCCESS;
+}
+
+
 int shan_notify_test_shared(shan_notification_t *const ptr
 			    , const int idx
 			    , int * const val
 			    )
 {
   volatile shan_notification_t *nid = ptr + idx;
-  volatile int res = nid->val;
+  int const res = __atomic_load_n(&(nid->val), __ATOMIC_ACQUIRE);
   
   *val =  res;
-  __sync_synchronize();
 
   return SHAN_SUCCESS;
 }
@@ -34,10 +34,10 @@
 #include "SHAN_comm.h"
 #include "SHAN_type.h"
 
-#include "shan_exchange.h"
 #include "gaspi_util.h"
 #include "shan_util.h"
 #include "shan_core.h"
+#include "shan_copy.h"
 #include "assert.h"
 
 
@@ -54,29 +54,79 @@ int shan_get_shared_type(type_local_t *type_info
 		      , local_rank
 		      , &shm_ptr);
 
+  shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
   shan_comm_get_type(type_info
-		     , shm_ptr
+		     , (char *) shm_ptr 
+		     + SYNC_SZ(num_neighbors)
+		     + neighborhood_id->num_type * MAILBOX_SZ(num_neighbors)
 		     , num_neighbors
-		     , &(neighborhood_id->type_element[type_id])
+		     , type_element->elemOffset
+		     , type_element->max_nelem_send
+		     , type_element->max_nelem_recv
+		     , type_element->offset_format
 		     ); 
   
   return SHAN_SUCCESS;
 }
 
 
+/*
+ * shared type of a node local neighbor, laid out 
+ * with the negotiated max elements of that neighbor
+ */
+static int shan_get_neighbor_type(type_local_t *type_info
+				  , shan_neighborhood_t *neighborhood_id
+				  , int idx
+				  , int type_id
+    )
+{
+    int j;
+    int const num_type = neighborhood_id->num_type;
+    long elemOffset = 0;
+    for (j = 0; j < type_id; ++j)
+    {
+	elemOffset += TYPE_ELEM_SZ(neighborhood_id->RemoteMaxNelemSend[idx * num_type + j]
+				   , neighborhood_id->RemoteMaxNelemRecv[idx * num_type + j]
+				   , neighborhood_id->type_element[j].offset_format);
+    }
+
+    void *shm_ptr;
+    shan_get_shared_ptr(&(neighborhood_id->shared_segment)
+			, neighborhood_id->local_rank[idx]
+			, &shm_ptr);
+
+    shan_comm_get_type(type_info
+		       , (char *) shm_ptr 
+		       + SYNC_SZ(neighborhood_id->RemoteNumNeighbors[idx])
+		       + num_type * MAILBOX_SZ(neighborhood_id->RemoteNumNeighbors[idx])
+		       , neighborhood_id->RemoteNumNeighbors[idx]
+		       , elemOffset
+		       , neighborhood_id->RemoteMaxNelemSend[idx * num_type + type_id]
+		       , neighborhood_id->RemoteMaxNelemRecv[idx * num_type + type_id]
+		       , neighborhood_id->type_element[type_id].offset_format
+	);
+
+    return SHAN_SUCCESS;
+}
+
+
 int shan_comm_get_type(type_local_t *type_info
 		       , void *shm_ptr
 		       , int num_neighbors
-		       , shan_element_t *type_element
+		       , long elemOffset
+		       , int max_nelem_send
+		       , int max_nelem_recv
+		       , int offset_format
 		       )
 {
-    long typeOffset          = num_neighbors * type_element->elemOffset;
-    int max_nelem_send       = type_element->max_nelem_send;
-    int max_nelem_recv       = type_element->max_nelem_recv;
+    long typeOffset          = num_neighbors * elemOffset;
+    long const desc_sz       = OFFSET_DESC_SZ(offset_format);
     long const maxSz = 
 	num_neighbors * MAX_SHARED_NOTIFICATION * sizeof(shan_notification_t)
-	+ 4 * num_neighbors * sizeof(int)
-	+ num_neighbors * (max_nelem_send + max_nelem_recv) * sizeof(long);
+	+ NELEM_TYPE_INT * num_neighbors * sizeof(int)
+	+ num_neighbors * (max_nelem_send + max_nelem_recv) * desc_sz;
+    long const intOffset     = typeOffset 
+	+ sizeof(shan_notification_t) * num_neighbors * MAX_SHARED_NOTIFICATION;
   
     type_info->nid            = (shan_notification_t*) ((char *) shm_ptr + typeOffset);
     typeOffset              += sizeof(shan_notification_t) * num_neighbors * MAX_SHARED_NOTIFICATION;
@@ -88,12 +138,42 @@ int shan_comm_get_type(type_local_t *type_info
     typeOffset              += num_neighbors * sizeof(int);
     type_info->recv_sz        = (int*) ((char*) shm_ptr + typeOffset);
     typeOffset              += num_neighbors * sizeof(int);
-    type_info->send_offset    = (long*) ((char*) shm_ptr + typeOffset);
-    typeOffset              += max_nelem_send * num_neighbors * sizeof(long);
-    type_info->recv_offset    = (long*) ((char*) shm_ptr + typeOffset);
-    typeOffset              += max_nelem_recv * num_neighbors * sizeof(long);
+    type_info->send_version   = (int*) ((char*) shm_ptr + typeOffset);
+    typeOffset              += num_neighbors * sizeof(int);
+    type_info->nblock_send    = (int*) ((char*) shm_ptr + typeOffset);
+    typeOffset              += num_neighbors * sizeof(int);
+    type_info->nblock_recv    = (int*) ((char*) shm_ptr + typeOffset);
+    typeOffset              += num_neighbors * sizeof(int);
+    type_info->recv_version   = (int*) ((char*) shm_ptr + typeOffset);
+    typeOffset              += num_neighbors * sizeof(int);
+    type_info->recv_ready     = (int*) ((char*) shm_ptr + typeOffset);
+    typeOffset              += num_neighbors * sizeof(int);
+    type_info->push_count     = (int*) ((char*) shm_ptr + typeOffset);
+    typeOffset              += num_neighbors * sizeof(int);
+    typeOffset               = intOffset + NELEM_TYPE_INT * num_neighbors * sizeof(int);
+
+    type_info->send_offset    = NULL;
+    type_info->recv_offset    = NULL;
+    type_info->send_block     = NULL;
+    type_info->recv_block     = NULL;
+    type_info->max_nelem_send = max_nelem_send;
+    type_info->max_nelem_recv = max_nelem_recv;
+    if (offset_format == SHAN_OFFSET_BLOCK)
+    {
+	type_info->send_block = (shan_offset_block_t*) ((char*) shm_ptr + typeOffset);
+	typeOffset          += max_nelem_send * num_neighbors * desc_sz;
+	type_info->recv_block = (shan_offset_block_t*) ((char*) shm_ptr + typeOffset);
+	typeOffset          += max_nelem_recv * num_neighbors * desc_sz;
+    }
+    else
+    {
+	type_info->send_offset = (long*) ((char*) shm_ptr + typeOffset);
+	typeOffset           += max_nelem_send * num_neighbors * desc_sz;
+	type_info->recv_offset = (long*) ((char*) shm_ptr + typeOffset);
+	typeOffset           += max_nelem_recv * num_neighbors * desc_sz;
+    }
 
-    ASSERT(typeOffset == num_neighbors * type_element->elemOffset + maxSz);
+    ASSERT(typeOffset == num_neighbors * elemOffset + maxSz);
 
     return SHAN_SUCCESS;
   
@@ -130,6 +210,191 @@ int shan_comm_type_offset(shan_neighborhood_t *neighborhood_id
 
 }
 
+int shan_comm_type_block(shan_neighborhood_t *neighborhood_id
+			 , int type_id
+			 , int **nelem_send
+			 , int **nelem_recv
+			 , int **send_sz
+			 , int **recv_sz
+			 , int **nblock_send
+			 , int **nblock_recv
+			 , shan_offset_block_t **send_block
+			 , shan_offset_block_t **recv_block
+			 )
+{
+    int const iProcLocal = neighborhood_id->iProcLocal;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    ASSERT(neighborhood_id->type_element[type_id].offset_format == SHAN_OFFSET_BLOCK);
+
+    type_local_t type_info;
+    shan_get_shared_type(&type_info
+			 , neighborhood_id
+			 , iProcLocal
+			 , num_neighbors
+			 , type_id
+	);
+            
+    *nelem_send    = type_info.nelem_send;
+    *nelem_recv    = type_info.nelem_recv;
+    *send_sz       = type_info.send_sz;
+    *recv_sz       = type_info.recv_sz;
+    *nblock_send   = type_info.nblock_send;
+    *nblock_recv   = type_info.nblock_recv;
+    *send_block    = type_info.send_block;
+    *recv_block    = type_info.recv_block;
+        
+    return SHAN_SUCCESS;
+
+}
+
+
+int shan_comm_type_commit(shan_neighborhood_t *neighborhood_id
+			  , int type_id
+			  )
+{
+    int idx;
+    int const iProcLocal = neighborhood_id->iProcLocal;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+
+    type_local_t type_info;
+    shan_get_shared_type(&type_info
+			 , neighborhood_id
+			 , iProcLocal
+			 , num_neighbors
+			 , type_id
+	);
+
+    int const version = ++(type_element->commit_count);
+    for (idx = 0; idx < num_neighbors; ++idx)
+    {
+	if (neighborhood_id->local_rank[idx] != -1)
+	{
+	    /*
+	     * type conversion plans are compiled by the receiver
+	     * (or the sender in push mode), which requires the 
+	     * offsets of both ranks.
+	     */
+	    type_info.send_version[idx] = version;
+	    type_info.recv_version[idx] = version;
+	}
+	else
+	{
+	    shan_copy_desc_t send_desc, recv_desc, linear;
+	    shan_copy_desc_send(&send_desc, &type_info, type_element, idx);
+	    shan_copy_desc_recv(&recv_desc, &type_info, type_element, idx);
+	    shan_copy_desc_linear(&linear);
+
+	    shan_copy_plan_t *const send_plan = &(type_element->send_plan[idx]);
+	    shan_copy_plan_compile(send_plan
+				   , &send_desc
+				   , &linear
+				   , type_info.nelem_send[idx]
+				   , type_info.send_sz[idx]
+		);
+	    send_plan->src_version = version;
+
+	    shan_copy_plan_t *const recv_plan = &(type_element->recv_plan[idx]);
+	    shan_copy_plan_compile(recv_plan
+				   , &linear
+				   , &recv_desc
+				   , type_info.nelem_recv[idx]
+				   , type_info.recv_sz[idx]
+		);
+	    recv_plan->dest_version = version;
+	}
+    }
+    __sync_synchronize();
+
+    return SHAN_SUCCESS;
+}
+
+
+int shan_comm_type_prepare(shan_neighborhood_t *neighborhood_id
+			   , int type_id
+			   )
+{
+    int idx, sid;
+    int const iProcLocal    = neighborhood_id->iProcLocal;
+    int const num_neighbors = neighborhood_id->num_neighbors;
+    int const num_type      = neighborhood_id->num_type;
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+
+    shan_get_shared_type(&(type_element->local_type)
+			 , neighborhood_id
+			 , iProcLocal
+			 , num_neighbors
+			 , type_id
+	);
+
+    void *shm_ptr;
+    shan_get_shared_ptr(&(neighborhood_id->shared_segment)
+			, iProcLocal
+			, &shm_ptr);
+    type_element->mailbox 
+	= (uint64_t *) ((char *) shm_ptr + SYNC_SZ(num_neighbors) 
+			+ type_id * MAILBOX_SZ(num_neighbors));
+
+    for (idx = 0; idx < num_neighbors; ++idx)
+    {
+	shan_handle_t *const handle = &(type_element->handle[idx]);
+	int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
+	int const RemoteNumNeighbors = neighborhood_id->RemoteNumNeighbors[idx];
+
+	handle->local_rank = neighborhood_id->local_rank[idx];
+	if (handle->local_rank != -1)
+	{
+	    shan_get_neighbor_type(&(handle->remote_type)
+				   , neighborhood_id
+				   , idx
+				   , type_id
+		);
+
+	    void *remote_ptr;
+	    shan_get_shared_ptr(&(neighborhood_id->shared_segment)
+				, handle->local_rank
+				, &remote_ptr);
+	    handle->remote_mailbox 
+		= (uint64_t *) ((char *) remote_ptr + SYNC_SZ(RemoteNumNeighbors) 
+				+ type_id * MAILBOX_SZ(RemoteNumNeighbors));
+	    handle->remote_mailbox_nword = MAILBOX_NWORD(RemoteNumNeighbors);
+	}
+	else
+	{
+	    memset(&(handle->remote_type), 0, sizeof(type_local_t));
+	    handle->remote_mailbox = NULL;
+	    handle->remote_mailbox_nword = 0;
+	}
+
+	int const num_buffer = type_element->num_buffer;
+	handle->send_sz            = type_element->SendSz[idx];
+	handle->recv_sz            = type_element->RecvSz[idx];
+	handle->send_buffer        = check_malloc(num_buffer * sizeof(long));
+	handle->recv_buffer        = check_malloc(num_buffer * sizeof(long));
+	handle->remote_recv_buffer = check_malloc(num_buffer * sizeof(long));
+	handle->remote_send_buffer = check_malloc(num_buffer * sizeof(long));
+	handle->notify_id          = check_malloc(num_buffer * sizeof(int));
+	for (sid = 0; sid < num_buffer; ++sid)
+	{
+	    handle->send_buffer[sid] 
+		= type_element->SendOffset[idx] + sid * handle->send_sz;
+	    handle->recv_buffer[sid] 
+		= type_element->RecvOffset[idx] + sid * handle->recv_sz;
+	    handle->remote_recv_buffer[sid] 
+		= type_element->RemoteRecvOffset[idx] + sid * handle->send_sz;
+	    handle->remote_send_buffer[sid] 
+		= type_element->RemoteSendOffset[idx] + sid * handle->recv_sz;
+	    handle->notify_id[sid] 
+		= GET_NOTIFICATION_ID(sid, num_type, type_id, RemoteNumNeighbors, RemoteCommIdx);
+	}
+	handle->batch_notify_id
+	    = GET_BATCH_NOTIFICATION_ID(neighborhood_id->num_buffer_max, num_type, type_id
+					, RemoteNumNeighbors, RemoteCommIdx);
+    }
+
+    return SHAN_SUCCESS;
+}
+
 
 int shan_comm_type_free(shan_segment_t *type_segment)
 {
@@ -141,6 +406,51 @@ int shan_comm_type_free(shan_segment_t *type_segment)
 
 
 
+/*
+ * type conversion between node local ranks, 
+ * (re)compiled once both ranks have committed
+ */
+static void shan_convert_local(shan_neighborhood_t *neighborhood_id
+			       , shan_element_t *const type_element
+			       , shan_copy_plan_t *const plan
+			       , void *const dest_ptr
+			       , shan_copy_desc_t const *const dest_desc
+			       , int const dest_version
+			       , void const *const src_ptr
+			       , shan_copy_desc_t const *const src_desc
+			       , int const src_version
+			       , int const nelem
+			       , int const elem_sz
+			       )
+{
+  if (src_version > 0 && dest_version > 0
+      && (plan->src_version != src_version || plan->dest_version != dest_version))
+    {
+      shan_copy_plan_compile(plan
+			     , src_desc
+			     , dest_desc
+			     , nelem
+			     , elem_sz
+			     );
+      plan->src_version  = src_version;
+      plan->dest_version = dest_version;
+    }
+
+  int const valid = src_version > 0 && dest_version > 0
+    && shan_copy_plan_valid(plan, nelem, elem_sz);
+  shan_copy_team(&(neighborhood_id->unpack_team)
+		 , valid ? plan : NULL
+		 , dest_ptr
+		 , dest_desc
+		 , src_ptr
+		 , src_desc
+		 , nelem
+		 , elem_sz
+		 , type_element->stream_threshold
+		 );
+}
+
+
 void shan_comm_get_local(shan_neighborhood_t *neighborhood_id
 			 , shan_segment_t *data_segment
 			 , int const type_id
@@ -148,40 +458,24 @@ void shan_comm_get_local(shan_neighborhood_t *neighborhood_id
 			 )
 {
   int const iProcLocal = neighborhood_id->iProcLocal;
-  int iProcRemote, i;
 
-  int const rank = neighborhood_id->neighbors[idx];
-  ASSERT ((iProcRemote = shan_comm_local_rank(neighborhood_id
-					      , rank
-					      )) != -1);  
+  shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+  shan_handle_t *const handle = &(type_element->handle[idx]);
+  int const iProcRemote = handle->local_rank;
+  ASSERT (iProcRemote != -1);  
   
   int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
-  int const RemoteNumNeighbors = neighborhood_id->RemoteNumNeighbors[idx];
 
-  type_local_t type_info_src;
-  shan_get_shared_type(&type_info_src
-		       , neighborhood_id
-		       , iProcRemote
-		       , RemoteNumNeighbors
-		       , type_id
-		       );
-  
-  int  src_nelem_send   = type_info_src.nelem_send[RemoteCommIdx];
-  int  src_send_sz      = type_info_src.send_sz[RemoteCommIdx];
-  long *src_send_offset = type_info_src.send_offset
-      + RemoteCommIdx * neighborhood_id->type_element[type_id].max_nelem_send;		      
-
-  type_local_t type_info_dest;
-  shan_get_shared_type(&type_info_dest
-		       , neighborhood_id
-		       , iProcLocal
-		       , neighborhood_id->num_neighbors
-		       , type_id
-		       );
+  type_local_t *const type_info_src = &(handle->remote_type);
+  int  src_nelem_send   = type_info_src->nelem_send[RemoteCommIdx];
+  int  src_send_sz      = type_info_src->send_sz[RemoteCommIdx];
+  shan_copy_desc_t src_desc;
+  shan_copy_desc_send(&src_desc, type_info_src, type_element, RemoteCommIdx);
 
-  int  dest_recv_sz      = type_info_dest.recv_sz[idx];
-  long *dest_recv_offset = type_info_dest.recv_offset
-    + idx * neighborhood_id->type_element[type_id].max_nelem_recv;    
+  type_local_t *const type_info_dest = &(type_element->local_type);
+  int  dest_recv_sz      = type_info_dest->recv_sz[idx];
+  shan_copy_desc_t dest_desc;
+  shan_copy_desc_recv(&dest_desc, type_info_dest, type_element, idx);
   ASSERT(src_send_sz    == dest_recv_sz);
 
   void *send_ptr, *recv_ptr;
@@ -193,19 +487,32 @@ void shan_comm_get_local(shan_neighborhood_t *neighborhood_id
 		      , iProcLocal
 		      , &recv_ptr);
 
-  for (i = 0; i < src_nelem_send; ++i)
+  /*
+   * data already pushed by the sender (push mode)
+   */
+  if (type_info_src->push_count[RemoteCommIdx] 
+      != type_element->local_recv_count[idx] + 1)
     {
-      void *restrict src  = (char*) send_ptr + src_send_offset[i];
-      void *restrict dest = (char* )recv_ptr + dest_recv_offset[i];
-      memcpy(dest, src, src_send_sz);
+      shan_convert_local(neighborhood_id
+			 , type_element
+			 , &(type_element->local_plan[idx])
+			 , recv_ptr
+			 , &dest_desc
+			 , type_element->commit_count
+			 , send_ptr
+			 , &src_desc
+			 , type_info_src->send_version[RemoteCommIdx]
+			 , src_nelem_send
+			 , src_send_sz
+			 );
     }
 
 #ifdef USE_VARIABLE_MESSAGE_LEN
-  type_info_dest.nelem_recv[idx] = src_nelem_send; 
-  type_info_dest.recv_sz[idx] = src_send_sz; 
+  type_info_dest->nelem_recv[idx] = src_nelem_send; 
+  type_info_dest->recv_sz[idx] = src_send_sz; 
 #else
-  ASSERT(type_info_dest.nelem_recv[idx] == src_nelem_send);
-  ASSERT(type_info_dest.recv_sz[idx] == src_send_sz);
+  ASSERT(type_info_dest->nelem_recv[idx] == src_nelem_send);
+  ASSERT(type_info_dest->recv_sz[idx] == src_send_sz);
 #endif  
 
   /*
@@ -223,48 +530,195 @@ void shan_comm_get_local(shan_neighborhood_t *neighborhood_id
 }
 
 
+void shan_comm_get_view(shan_neighborhood_t *neighborhood_id
+			, shan_segment_t *data_segment
+			, int const type_id
+			, int const idx
+			, shan_view_t *view
+			)
+{
+  shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+  shan_handle_t *const handle = &(type_element->handle[idx]);
+  ASSERT (handle->local_rank != -1);  
+
+  int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
+  type_local_t *const type_info_src = &(handle->remote_type);
+  type_local_t *const type_info_dest = &(type_element->local_type);
+  int  src_nelem_send   = type_info_src->nelem_send[RemoteCommIdx];
+  int  src_send_sz      = type_info_src->send_sz[RemoteCommIdx];
+
+  void *base_ptr;
+  shan_copy_desc_t desc;
+  if (type_info_src->push_count[RemoteCommIdx] 
+      == type_element->local_recv_count[idx] + 1)
+    {
+      /*
+       * pushed, own receive locations
+       */
+      shan_get_shared_ptr(data_segment
+			  , neighborhood_id->iProcLocal
+			  , &base_ptr);
+      shan_copy_desc_recv(&desc, type_info_dest, type_element, idx);
+    }
+  else
+    {
+      shan_get_shared_ptr(data_segment
+			  , handle->local_rank
+			  , &base_ptr);
+      shan_copy_desc_send(&desc, type_info_src, type_element, RemoteCommIdx);
+    }
+
+  view->base    = base_ptr;
+  view->nelem   = src_nelem_send;
+  view->elem_sz = src_send_sz;
+  view->offset  = desc.offset;
+  view->block   = desc.block;
+  view->nblock  = desc.nblock;
+
+#ifdef USE_VARIABLE_MESSAGE_LEN
+  type_info_dest->nelem_recv[idx] = src_nelem_send; 
+  type_info_dest->recv_sz[idx] = src_send_sz; 
+#else
+  ASSERT(type_info_dest->nelem_recv[idx] == src_nelem_send);
+  ASSERT(type_info_dest->recv_sz[idx] == src_send_sz);
+#endif  
+
+  /*
+   * no 'have read' here, see shan_comm_release_view
+   */
+  ++(neighborhood_id->type_element[type_id].local_recv_count[idx]);
+}
+
+
+void shan_comm_recv_ready(shan_neighborhood_t *neighborhood_id
+			  , int const type_id
+			  , int const idx
+			  )
+{
+  shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+  if (type_element->push)
+    {
+      __atomic_store_n(&(type_element->local_type.recv_ready[idx])
+		       , type_element->local_recv_count[idx] + 1
+		       , __ATOMIC_RELEASE);
+    }
+}
+
+
+int shan_comm_put_local(shan_neighborhood_t *neighborhood_id
+			, shan_segment_t *data_segment
+			, int const type_id
+			, int const idx
+			)
+{
+  shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+  shan_handle_t *const handle = &(type_element->handle[idx]);
+  ASSERT (handle->local_rank != -1);  
+
+  int const RemoteCommIdx = neighborhood_id->RemoteCommIndex[idx];
+  int const stage = type_element->local_send_count[idx] + 1;
+  type_local_t *const type_info_dest = &(handle->remote_type);
+  if (!type_element->push
+      || __atomic_load_n(&(type_info_dest->recv_ready[RemoteCommIdx])
+			 , __ATOMIC_ACQUIRE) != stage)
+    {
+      return 0;
+    }
+
+  type_local_t *const type_info_src = &(type_element->local_type);
+  int  src_nelem_send   = type_info_src->nelem_send[idx];
+  int  src_send_sz      = type_info_src->send_sz[idx];
+  shan_copy_desc_t src_desc;
+  shan_copy_desc_send(&src_desc, type_info_src, type_element, idx);
+
+  shan_copy_desc_t dest_desc;
+  shan_copy_desc_recv(&dest_desc, type_info_dest, type_element, RemoteCommIdx);
+  ASSERT(src_send_sz == type_info_dest->recv_sz[RemoteCommIdx]);
+
+  void *send_ptr, *recv_ptr;
+  shan_get_shared_ptr(data_segment
+		      , neighborhood_id->iProcLocal
+		      , &send_ptr);
+
+  shan_get_shared_ptr(data_segment
+		      , handle->local_rank
+		      , &recv_ptr);
+
+  shan_convert_local(neighborhood_id
+		     , type_element
+		     , &(type_element->push_plan[idx])
+		     , recv_ptr
+		     , &dest_desc
+		     , type_info_dest->recv_version[RemoteCommIdx]
+		     , send_ptr
+		     , &src_desc
+		     , type_element->commit_count
+		     , src_nelem_send
+		     , src_send_sz
+		     );
+
+  /*
+   * published with the 'have written' notification
+   */
+  type_info_src->push_count[idx] = stage;
+
+  return 1;
+}
+
+
 void shan_comm_get_remote(shan_neighborhood_t *neighborhood_id
 			 , shan_segment_t *data_segment
 			 , int const type_id
 			 , int const idx
 			 )
 {
-    int i;
     int const iProcLocal    = neighborhood_id->iProcLocal;
-    int const num_neighbors = neighborhood_id->num_neighbors;
   
     int const sid 
-	= (neighborhood_id->type_element[type_id].local_recv_count[idx]) % 2;  
+	= (neighborhood_id->type_element[type_id].local_recv_count[idx])
+	% neighborhood_id->type_element[type_id].num_buffer;  
     shan_remote_t *const remote_segment = &(neighborhood_id->remote_segment);
-
-    type_local_t type_info;
-    shan_get_shared_type(&type_info
-			 , neighborhood_id
-			 , iProcLocal
-			 , num_neighbors
-			 , type_id
+    shan_element_t *const type_element = &(neighborhood_id->type_element[type_id]);
+
+    type_local_t *const type_info = &(type_element->local_type);
+    int const recv_sz = type_info->recv_sz[idx];	  
+    int const nelem_recv = type_info->nelem_recv[idx];	  
+    shan_copy_desc_t recv_desc, linear;
+    shan_copy_desc_recv(&recv_desc
+			, type_info
+			, type_element
+			, idx
 	);
-
-    int const recv_sz = type_info.recv_sz[idx];	  
-    int const nelem_recv = type_info.nelem_recv[idx];	  
-    long *const recv_offset = type_info.recv_offset
-	+ idx * neighborhood_id->type_element[type_id].max_nelem_recv;
+    shan_copy_desc_linear(&linear);
     
-    long comm_buffer_offset = num_neighbors * neighborhood_id->type_element[type_id].RecvOffset[sid]
-        + idx * neighborhood_id->type_element[type_id].maxRecvSz;    
+    long comm_buffer_offset = type_element->handle[idx].recv_buffer[sid];
     void *comm_ptr = (char*) remote_segment->shan_ptr + comm_buffer_offset;
     
     void *data_ptr;
     shan_get_shared_ptr(data_segment
 			, iProcLocal
 			, &data_ptr);
-    
-    for (i = 0; i < nelem_recv; ++i)
+
+    /* 
+     * data placed directly by sender, nothing to unpack
+     */
+    int const direct_mode = *((int *) comm_ptr + 3);
+
+    void *const recv_buf = (char*) comm_ptr + NELEM_COMM_HEADER * sizeof(int);
+    shan_copy_plan_t *const plan
+	= &(neighborhood_id->type_element[type_id].recv_plan[idx]);
+    if (!direct_mode)
     {
-	void *restrict src  = (char*) comm_ptr 
-	    + NELEM_COMM_HEADER * sizeof(int) + i * recv_sz;
-	void *restrict dest = (char*) data_ptr + recv_offset[i];
-	memcpy(dest, src, recv_sz);
+	shan_copy_team(&(neighborhood_id->unpack_team)
+		       , shan_copy_plan_valid(plan, nelem_recv, recv_sz) ? plan : NULL
+		       , data_ptr
+		       , &recv_desc
+		       , recv_buf
+		       , &linear
+		       , nelem_recv
+		       , recv_sz
+		       , type_element->stream_threshold
+	    );
     }
     
     ++(neighborhood_id->type_element[type_id].local_recv_count[idx]);